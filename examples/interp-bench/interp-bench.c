@@ -0,0 +1,54 @@
+/* Interpreter throughput benchmark.
+ *
+ * Runs a single concrete path through integer arithmetic, shifts, signed
+ * division and comparisons at 8, 16, 32 and 64 bits, so nearly all the
+ * time is spent executing instructions rather than solving queries:
+ *
+ *   llvm-gcc -I ../../include -O0 -c -emit-llvm interp-bench.c
+ *   klee interp-bench.o
+ *   grep "instructions per second" klee-last/info
+ *
+ * Pass a round count as the first argument (with --posix-runtime) to
+ * lengthen the run.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static int8_t mix8(int8_t a, int8_t b) {
+  int8_t d = b | 1;
+  return (a >> 1) + (a / d) - (a < b ? a : b);
+}
+
+static int16_t mix16(int16_t a, int16_t b) {
+  int16_t d = b | 1;
+  return (a << 3) ^ (a % d) ^ (a > b);
+}
+
+static int32_t mix32(int32_t a, int32_t b) {
+  int32_t d = (b & 0xffff) | 1;
+  return (a * 31) + (a / d) + ((uint32_t) a >> 7) + (a <= b);
+}
+
+static int64_t mix64(int64_t a, int64_t b) {
+  int64_t d = (b & 0xffff) | 1;
+  return (a * 1103515245) ^ (a % d) ^ (a >> 13) ^ (a >= b);
+}
+
+int main(int argc, char **argv) {
+  unsigned rounds = argc > 1 ? atoi(argv[1]) : 200000;
+  int8_t a8 = 3;
+  int16_t a16 = 5;
+  int32_t a32 = 7;
+  int64_t a64 = 11;
+  unsigned i;
+
+  for (i = 0; i != rounds; ++i) {
+    a8 = mix8(a8, (int8_t) i);
+    a16 = mix16(a16, (int16_t) i);
+    a32 = mix32(a32, (int32_t) i);
+    a64 = mix64(a64, (int64_t) i);
+  }
+
+  return (int) (a8 ^ a16 ^ a32 ^ a64) & 1;
+}
@@ -12,6 +12,9 @@
 
 #include "klee/Expr.h"
 
+#include <iterator>
+#include <vector>
+
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
 // move the first usage into a separate data structure
@@ -21,21 +24,73 @@ namespace klee {
 class ExprVisitor;
   
 class ConstraintManager {
-public:
-  typedef std::vector< ref<Expr> > constraints_ty;
-  typedef constraints_ty::iterator iterator;
-  typedef constraints_ty::const_iterator const_iterator;
+  /// A constraint in a persistent list linking each constraint to the
+  /// previously added ones. Copies of a manager (such as the constraints of
+  /// forked states) share the common older part of the list.
+  struct Node {
+    unsigned refCount;
+    ref<Expr> expr;
+    Node *next;
 
-  ConstraintManager() {}
+    Node(ref<Expr> _expr, Node *_next) : refCount(1), expr(_expr), next(_next) {}
+  };
+
+public:
+  /// Iterates over the constraints, most recently added first.
+  class const_iterator 
+    : public std::iterator<std::forward_iterator_tag, ref<Expr>, ptrdiff_t,
+                           const ref<Expr>*, const ref<Expr>&> {
+    const Node *node;
+
+  public:
+    const_iterator(const Node *_node = 0) : node(_node) {}
+
+    const ref<Expr> &operator*() const { return node->expr; }
+    const ref<Expr> *operator->() const { return &node->expr; }
+
+    const_iterator &operator++() {
+      node = node->next;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator it = *this;
+      node = node->next;
+      return it;
+    }
+
+    bool operator==(const const_iterator &b) const { return node == b.node; }
+    bool operator!=(const const_iterator &b) const { return node != b.node; }
+  };
+  typedef const_iterator iterator;
+  typedef const_iterator constraint_iterator;
+
+  ConstraintManager() : head(0), numConstraints(0) {}
 
   // create from constraints with no optimization
   explicit
-  ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+  ConstraintManager(const std::vector< ref<Expr> > &_constraints) 
+    : head(0), numConstraints(0) {
+    for (std::vector< ref<Expr> >::const_iterator it = _constraints.begin(),
+           ie = _constraints.end(); it != ie; ++it)
+      push(*it);
+  }
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  ConstraintManager(const ConstraintManager &cs) 
+    : head(cs.head), numConstraints(cs.numConstraints) {
+    if (head)
+      ++head->refCount;
+  }
 
-  typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
+  ~ConstraintManager() { release(head); }
+
+  ConstraintManager &operator=(const ConstraintManager &cs) {
+    if (cs.head)
+      ++cs.head->refCount;
+    release(head);
+    head = cs.head;
+    numConstraints = cs.numConstraints;
+    return *this;
+  }
 
   // given a constraint which is known to be valid, attempt to 
   // simplify the existing constraint set
@@ -46,30 +101,44 @@ public:
   void addConstraint(ref<Expr> e);
   
   bool empty() const {
-    return constraints.empty();
+    return !head;
   }
   ref<Expr> back() const {
-    return constraints.back();
+    return head->expr;
   }
   constraint_iterator begin() const {
-    return constraints.begin();
+    return const_iterator(head);
   }
   constraint_iterator end() const {
-    return constraints.end();
+    return const_iterator();
   }
   size_t size() const {
-    return constraints.size();
+    return numConstraints;
   }
 
-  bool operator==(const ConstraintManager &other) const {
-    return constraints == other.constraints;
-  }
+  bool operator==(const ConstraintManager &other) const;
   
   /// Dump the contents of this constraint set for debugging purposes.
   void dump(std::ostream &out) const;
 
 private:
-  std::vector< ref<Expr> > constraints;
+  Node *head;
+  size_t numConstraints;
+
+  void push(ref<Expr> e) {
+    head = new Node(e, head);
+    ++numConstraints;
+  }
+
+  // Drop a reference to a list, freeing the nodes no longer shared
+  // (iteratively, lists can be long).
+  static void release(Node *n) {
+    while (n && --n->refCount == 0) {
+      Node *next = n->next;
+      delete n;
+      n = next;
+    }
+  }
 
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
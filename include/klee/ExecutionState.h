@@ -39,8 +39,13 @@ struct StackFrame {
   KFunction *kf;
   CallPathNode *callPathNode;
 
-  std::vector<const MemoryObject*> allocas;
+  std::vector< ref<const MemoryObject> > allocas;
+
+  /// Registers of the frame. Copies of a frame (made when a state forks)
+  /// share them until one of the copies writes a register, so read them
+  /// with getLocal() and write them through getLocalForWrite().
   Cell *locals;
+  unsigned *localsRefCount;
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -59,6 +64,19 @@ struct StackFrame {
   StackFrame(KInstIterator caller, KFunction *kf);
   StackFrame(const StackFrame &s);
   ~StackFrame();
+
+  const Cell &getLocal(unsigned index) const {
+    return locals[index];
+  }
+
+  Cell &getLocalForWrite(unsigned index) {
+    if (*localsRefCount > 1)
+      unshareLocals();
+    return locals[index];
+  }
+
+private:
+  void unshareLocals();
 };
 
 class ExecutionState {
@@ -94,10 +112,26 @@ public:
   std::map<const std::string*, std::set<unsigned> > coveredLines;
   PTreeNode *ptreeNode;
 
+  /// Number of instructions stepped along this path since the initial
+  /// state, used to rebuild evicted states.
+  uint64_t steppedInstructions;
+
+  /// False once the state has been evicted: only its path through the
+  /// process tree and its bookkeeping are kept. \see evict()
+  bool resident;
+
+  /// The hash of the path condition of an evicted state, which the rebuilt
+  /// state must match. \see computePathConditionHash()
+  uint64_t evictedConstraintsHash;
+
+  /// Set once the path has made an external call. Such a state cannot be
+  /// rebuilt by re-execution, so it is never evicted.
+  bool madeExternalCall;
+
   /// ordered list of symbolics: used to generate test cases. 
   //
   // FIXME: Move to a shared list structure (not critical).
-  std::vector< std::pair<const MemoryObject*, const Array*> > symbolics;
+  std::vector< std::pair<ref<const MemoryObject>, const Array*> > symbolics;
 
   // Used by the checkpoint/rollback methods for fake objects.
   // FIXME: not freeing things on branch deletion.
@@ -114,7 +148,9 @@ public:
   void removeFnAlias(std::string fn);
   
 private:
-  ExecutionState() : fakeState(false), underConstrained(0), ptreeNode(0) {}
+  ExecutionState() : fakeState(false), underConstrained(0), ptreeNode(0),
+                     steppedInstructions(0), resident(true),
+                     evictedConstraintsHash(0), madeExternalCall(false) {}
 
 public:
   ExecutionState(KFunction *kf);
@@ -130,13 +166,33 @@ public:
   void pushFrame(KInstIterator caller, KFunction *kf);
   void popFrame();
 
-  void addSymbolic(const MemoryObject *mo, const Array *array) { 
-    symbolics.push_back(std::make_pair(mo, array));
-  }
+  void addSymbolic(const MemoryObject *mo, const Array *array);
   void addConstraint(ref<Expr> e) { 
     constraints.addConstraint(e); 
   }
 
+  /// Drop the stack, constraints and address space of the state to
+  /// release memory. The executor rebuilds the state by re-executing its
+  /// path before it runs again.
+  void evict();
+
+  /// Return a hash of everything that determines how the state continues:
+  /// its pc, stack, memory and constraints. States with equal hashes are
+  /// (up to collisions) redundant with one another. Memory is hashed
+  /// incrementally, see AddressSpace::hash().
+  uint64_t computeHash() const;
+
+  /// Return a hash of the constraints, independent of their order. It is 0
+  /// for an empty path condition.
+  uint64_t computeConstraintsHash() const;
+
+  /// Return a hash of the constraints like computeConstraintsHash(), but
+  /// with arrays identified by their position among the symbolics (or by
+  /// their contents, for constant arrays) instead of by name. It therefore
+  /// stays the same for a state rebuilt by re-executing its path, which
+  /// names its arrays anew.
+  uint64_t computePathConditionHash() const;
+
   bool merge(const ExecutionState &b);
   void dumpStack(std::ostream &out) const;
 };
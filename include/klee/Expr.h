@@ -705,6 +705,9 @@ public:
 private:
   /// size of this update sequence, including this update
   unsigned size;
+
+  /// whether this and all older updates write constants at constant indices
+  bool concrete;
   
 public:
   UpdateNode(const UpdateNode *_next, 
@@ -713,6 +716,10 @@ public:
 
   unsigned getSize() const { return size; }
 
+  /// isConcrete - Whether every update in this sequence writes a constant
+  /// value at a constant index.
+  bool isConcrete() const { return concrete; }
+
   int compare(const UpdateNode &b) const;  
   unsigned hash() const { return hashValue; }
 
@@ -15,8 +15,68 @@
 namespace klee {
   class MemoryObject;
 
+  /// A register or constant slot.
+  ///
+  /// Concrete values of at most 64 bits produced by the interpreter's fast
+  /// paths are kept inline (tagged by a non-zero concreteWidth) so that no
+  /// ConstantExpr has to be allocated for them. Everything else is held as
+  /// an expression.
   struct Cell {
-    ref<Expr> value;
+  private:
+    ref<Expr> expr;
+    uint64_t concreteValue;
+    Expr::Width concreteWidth;
+
+  public:
+    Cell() : concreteValue(0), concreteWidth(0) {}
+
+    bool isNull() const { return !concreteWidth && expr.isNull(); }
+
+    /// isConcrete - Return true if the cell holds an integer constant of at
+    /// most 64 bits, either inline or as a ConstantExpr.
+    bool isConcrete() const {
+      if (concreteWidth)
+        return true;
+      return !expr.isNull() && isa<ConstantExpr>(expr) &&
+        expr->getWidth() <= Expr::Int64;
+    }
+
+    /// getConcreteValue - Return the zero-extended value of a concrete cell.
+    uint64_t getConcreteValue() const {
+      assert(isConcrete() && "cell is not concrete");
+      if (concreteWidth)
+        return concreteValue;
+      return cast<ConstantExpr>(expr)->getZExtValue();
+    }
+
+    /// getConcreteWidth - Return the width of a concrete cell.
+    Expr::Width getConcreteWidth() const {
+      assert(isConcrete() && "cell is not concrete");
+      if (concreteWidth)
+        return concreteWidth;
+      return expr->getWidth();
+    }
+
+    /// getValue - Return the cell contents as an expression, materializing a
+    /// ConstantExpr for inline values.
+    ref<Expr> getValue() const {
+      if (concreteWidth)
+        return ConstantExpr::create(concreteValue, concreteWidth);
+      return expr;
+    }
+
+    void setValue(ref<Expr> e) {
+      expr = e;
+      concreteWidth = 0;
+    }
+
+    void setConcrete(uint64_t v, Expr::Width w) {
+      assert(w && w <= Expr::Int64 && "invalid inline width");
+      assert(v == bits64::truncateToNBits(v, w) && "invalid constant");
+      expr = ref<Expr>();
+      concreteValue = v;
+      concreteWidth = w;
+    }
   };
 }
 
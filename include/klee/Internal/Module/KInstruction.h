@@ -28,6 +28,12 @@ namespace klee {
   class KModule;
 
 
+  /// ConcreteHandler - Evaluate an instruction over concrete operands of
+  /// the given width. The result is truncated to the instruction width by
+  /// the caller. Returns false if the general path must be taken.
+  typedef bool (*ConcreteHandler)(uint64_t left, uint64_t right,
+                                  unsigned width, uint64_t &result);
+
   /// KInstruction - Intermediate instruction representation used
   /// during execution.
   struct KInstruction {
@@ -42,6 +48,23 @@ namespace klee {
     /// Destination register index.
     unsigned dest;
 
+    /// Width in bits of the instruction result, or zero if it is unsized.
+    unsigned width;
+
+    /// Handler for the case where every operand is concrete, or null if the
+    /// instruction always takes the general path.
+    ConcreteHandler concreteHandler;
+    /// Width in bits of the first operand, passed to the concrete handler.
+    unsigned operandWidth;
+    /// Bit j is set if operand j is a module constant with a concrete value,
+    /// which is then held in constantOperands[j].
+    unsigned constantMask;
+    uint64_t constantOperands[2];
+
+    /// Index into KModule::simdNames of the SIMD operation starting at this
+    /// instruction, or -1.
+    int simdIndex;
+
   public:
     virtual ~KInstruction(); 
   };
@@ -14,6 +14,7 @@
 
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 namespace llvm {
@@ -101,6 +102,12 @@ namespace klee {
 
     Cell *constantTable;
 
+    /// With -instrument-simd, the names of the SIMD operations in the
+    /// module (\see KInstruction::simdIndex), and the first instruction of
+    /// each operation.
+    std::vector<std::string> simdNames;
+    std::map<llvm::Instruction*, unsigned> simdInstructions;
+
   public:
     KModule(llvm::Module *_module);
     ~KModule();
@@ -17,6 +17,7 @@ class StringRef;
 namespace klee {
 
 bool isSIMDInstruction(llvm::Instruction *i);
+bool isUnsupportedSIMDIntrinsic(llvm::Instruction *i);
 llvm::StringRef getIntrinsicOrInstructionName(llvm::Instruction *i);
 
 }
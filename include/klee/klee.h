@@ -145,12 +145,6 @@ extern "C" {
   /* Dump constraint set. */
   void klee_dump_constraints(void);
 
-  /* Number of SSE instructions executed. */
-  extern unsigned klee_sse_count;
-
-  /* Callback for each SSE instruction executed. */
-  void klee_sse(char *name, char *file, unsigned line, char* func, char *inst);
-
   /* Add a memory watchpoint at the given address. */
   void klee_watch(void *, size_t);
 
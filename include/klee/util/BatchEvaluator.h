@@ -0,0 +1,94 @@
+//===-- BatchEvaluator.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_BATCHEVALUATOR_H
+#define KLEE_UTIL_BATCHEVALUATOR_H
+
+#include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <vector>
+
+namespace klee {
+  class Array;
+  class Assignment;
+
+  /// BatchEvaluator - Evaluate a fixed set of expressions under many
+  /// assignments at once.
+  ///
+  /// The expressions are compiled once into a flat tape of instructions in
+  /// dependency order. Evaluation runs each instruction over a block of
+  /// assignments, with the values of one instruction for all assignments in
+  /// the block stored contiguously, so the common integer operations are
+  /// plain loops over arrays. Only expressions whose nodes are at most 64
+  /// bits wide can be compiled.
+  ///
+  /// An assignment is undetermined if the expressions could not be compiled
+  /// or if under it they do not evaluate to constants (a division by zero, or
+  /// an unbound byte of an assignment that allows free values). Callers
+  /// should fall back to Assignment::evaluate for those.
+  class BatchEvaluator {
+    struct Instruction {
+      Expr::Kind kind;
+      Expr::Width width;
+      unsigned numKids;
+      unsigned kids[3];
+      /// The constant value, or the extract offset.
+      uint64_t value;
+      /// The source node, for the operations evaluated through the
+      /// constant folder.
+      const Expr *expr;
+      /// For reads, the array and the range of its update slot pairs.
+      unsigned array, firstUpdate, numUpdates;
+    };
+
+    std::vector< ref<Expr> > roots;
+    std::vector<unsigned> rootSlots;
+    std::vector<Instruction> tape;
+    /// Pairs of (index, value) slots for the updates of each read.
+    std::vector<unsigned> updates;
+    std::vector<const Array*> arrays;
+    bool valid;
+
+    unsigned numLanes;
+    /// The number of lanes each slot has room for in the values buffer of
+    /// evaluateBlock.
+    unsigned stride;
+    std::vector<uint64_t> results;
+    std::vector<bool> determined;
+
+    unsigned compile(const ref<Expr> &e, ExprHashMap<unsigned> &slots);
+    void evaluateBlock(const Assignment *const *assignments, unsigned count,
+                       std::vector<uint64_t> &values,
+                       std::vector<unsigned char> &ok);
+
+  public:
+    explicit BatchEvaluator(const ref<Expr> &e);
+    explicit BatchEvaluator(const std::vector< ref<Expr> > &roots);
+
+    /// isValid - Whether the expressions could be compiled.
+    bool isValid() const { return valid; }
+
+    /// evaluate - Evaluate the expressions under each of \arg assignments,
+    /// replacing the results of any earlier call.
+    void evaluate(const std::vector<const Assignment*> &assignments);
+
+    /// isDetermined - Whether all expressions evaluated to constants under
+    /// assignment \arg lane.
+    bool isDetermined(unsigned lane) const { return determined[lane]; }
+
+    /// getValue - The value of expression \arg root under the determined
+    /// assignment \arg lane.
+    uint64_t getValue(unsigned root, unsigned lane) const {
+      return results[root*numLanes + lane];
+    }
+  };
+}
+
+#endif
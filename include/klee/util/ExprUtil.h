@@ -38,6 +38,12 @@ namespace klee {
                            InputIterator end,
                            std::vector<const Array*> &results);
 
+  /// Split a vector value into lanes of the given width, lowest lane
+  /// first. The concatenations the value is built from are taken apart in
+  /// one pass, instead of extracting each lane from the whole value.
+  void getVectorLanes(const ref<Expr> &e, unsigned laneWidth,
+                      std::vector< ref<Expr> > &lanes);
+
 }
 
 #endif
@@ -19,16 +19,56 @@ using namespace klee;
 
 ///
 
+uint64_t AddressSpace::hashBinding(const MemoryObject *mo, 
+                                   const ObjectState *os) {
+  if (!os->hasBoundHash) {
+    os->boundHash = os->hash();
+    os->hasBoundHash = true;
+  }
+  uint64_t h = (mo->id + 1) * 0x9E3779B97F4A7C15ULL ^ os->boundHash;
+  h ^= h >> 31;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  return h ^ (h >> 29);
+}
+
+void AddressSpace::markDirty(const MemoryObject *mo) {
+  if (dirtyObjects.insert(mo).second)
+    if (const ObjectState *os = findObject(mo))
+      objectsHash -= hashBinding(mo, os);
+}
+
+uint64_t AddressSpace::hash() const {
+  for (std::set<const MemoryObject*>::iterator it = dirtyObjects.begin(), 
+         ie = dirtyObjects.end(); it != ie; ++it) {
+    const ObjectState *os = findObject(*it);
+    assert(os && "dirty object is not bound");
+    objectsHash += hashBinding(*it, os);
+  }
+  dirtyObjects.clear();
+  return objectsHash;
+}
+
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
+  // The caller usually initializes the object after binding it.
+  markDirty(mo);
   objects = objects.replace(std::make_pair(mo, os));
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
+  if (!dirtyObjects.erase(mo))
+    if (const ObjectState *os = findObject(mo))
+      objectsHash -= hashBinding(mo, os);
   objects = objects.remove(mo);
 }
 
+void AddressSpace::clear() {
+  objects = MemoryMap();
+  objectsHash = 0;
+  dirtyObjects.clear();
+}
+
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
   const MemoryMap::value_type *res = objects.lookup(mo);
   
@@ -39,7 +79,11 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
                                         const ObjectState *os) {
   assert(!os->readOnly);
 
+  markDirty(mo);
   if (cowKey==os->copyOnWriteOwner) {
+    // An owned object is bound in this address space only, so its
+    // recorded hash is in no other sum.
+    os->hasBoundHash = false;
     return const_cast<ObjectState*>(os);
   } else {
     ObjectState *n = new ObjectState(*os);
@@ -68,6 +112,178 @@ bool AddressSpace::resolveOne(const ref<ConstantExpr> &addr,
   return false;
 }
 
+/// Return the end address used when bounding a pointer against \a mo. Zero
+/// sized objects are treated as occupying their base address only.
+static ref<Expr> getObjectEnd(const MemoryObject *mo) {
+  return AddExpr::create(mo->getBaseExpr(),
+                         Expr::createPointer(mo->size ? mo->size : 1));
+}
+
+/// Append the next object of \a objects from \a it to \a seq, walking
+/// upwards in address order if \a forward and downwards otherwise.
+///
+/// \return false if there are no more objects in that direction.
+static bool fetchObject(const MemoryMap &objects, MemoryMap::iterator &it,
+                        bool forward, ResolutionList &seq) {
+  if (forward) {
+    if (it == objects.end())
+      return false;
+    seq.push_back(*it);
+    ++it;
+  } else {
+    if (it == objects.begin())
+      return false;
+    --it;
+    seq.push_back(*it);
+  }
+  return true;
+}
+
+/// Count the objects next to \a it, in the direction given by \a forward,
+/// that the pointer \a p may still reach: walking upwards, those whose base
+/// \a p may lie at or above, and walking downwards, those whose end \a p
+/// may lie below. Only a prefix of the objects in either direction is
+/// reachable, and its length is found by galloping followed by a binary
+/// search, so the number of queries is logarithmic and no more than about
+/// twice the reachable objects are visited. The visited objects are left in
+/// \a seq, nearest first.
+///
+/// \return false if a query failed.
+static bool countReachable(ExecutionState &state,
+                           TimingSolver *solver,
+                           ref<Expr> p,
+                           const MemoryMap &objects,
+                           MemoryMap::iterator it,
+                           bool forward,
+                           ResolutionList &seq,
+                           unsigned &count) {
+  // The pointer may reach every object before lo; once hi is bracketed it
+  // cannot reach the object at hi.
+  unsigned lo = 0, hi = 0, step = 1;
+  for (;;) {
+    unsigned probe = lo + step - 1;
+    while (seq.size() <= probe && fetchObject(objects, it, forward, seq))
+      ;
+    if (seq.size() <= lo) {
+      count = seq.size();
+      return true;
+    }
+    if (probe >= seq.size())
+      probe = seq.size() - 1;
+
+    const MemoryObject *mo = seq[probe].first.get();
+    ref<Expr> reach = forward ? UgeExpr::create(p, mo->getBaseExpr()) :
+                                UltExpr::create(p, getObjectEnd(mo));
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(state, reach, mayBeTrue))
+      return false;
+    if (!mayBeTrue) {
+      hi = probe;
+      break;
+    }
+    lo = probe + 1;
+    step *= 2;
+  }
+
+  while (lo < hi) {
+    unsigned mid = lo + (hi - lo) / 2;
+    const MemoryObject *mo = seq[mid].first.get();
+    ref<Expr> reach = forward ? UgeExpr::create(p, mo->getBaseExpr()) :
+                                UltExpr::create(p, getObjectEnd(mo));
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(state, reach, mayBeTrue))
+      return false;
+    if (mayBeTrue) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  count = lo;
+  return true;
+}
+
+/// Compute the interval of objects (in address order) the symbolic pointer
+/// \a p may point into, given a feasible \a example value of it.
+///
+/// The search starts from the objects around the example in the address
+/// map and extends the interval downwards and upwards only as far as the
+/// pointer may reach, so objects lying entirely below min(p) or above
+/// max(p) are neither queried nor visited.
+///
+/// \return false if a query failed.
+static bool getCandidateInterval(ExecutionState &state,
+                                 TimingSolver *solver,
+                                 ref<Expr> p,
+                                 uint64_t example,
+                                 const MemoryMap &objects,
+                                 ResolutionList &candidates) {
+  // Objects below the pivot start at or below the example, the others above
+  // it.
+  MemoryObject hack(example);
+  MemoryMap::iterator pivot = objects.upper_bound(&hack);
+
+  ResolutionList below, above;
+  unsigned numBelow, numAbove;
+  if (!countReachable(state, solver, p, objects, pivot, false, 
+                      below, numBelow))
+    return false;
+  if (!countReachable(state, solver, p, objects, pivot, true, 
+                      above, numAbove))
+    return false;
+
+  candidates.assign(below.rend() - numBelow, below.rend());
+  candidates.insert(candidates.end(), above.begin(), above.begin() + numAbove);
+  return true;
+}
+
+/// Classify the candidates in [begin, end) by asking whether the pointer may
+/// fall anywhere within their hull, recursing into halves only when it
+/// may. Objects that are feasible are appended to \a rl in address order.
+///
+/// \return true iff the classification is incomplete (a query failed or
+/// timed out, or \a maxResolutions was reached).
+static bool classifyCandidates(ExecutionState &state,
+                               TimingSolver *solver,
+                               ref<Expr> p,
+                               const ResolutionList &candidates,
+                               unsigned begin, unsigned end,
+                               ResolutionList &rl,
+                               unsigned maxResolutions,
+                               TimerStatIncrementer &timer,
+                               uint64_t timeout_us) {
+  if (begin == end)
+    return false;
+  if (timeout_us && timeout_us < timer.check())
+    return true;
+
+  ref<Expr> inBounds;
+  if (end - begin == 1) {
+    inBounds = candidates[begin].first->getBoundsCheckPointer(p);
+  } else {
+    inBounds = 
+      AndExpr::create(UgeExpr::create(p, candidates[begin].first->getBaseExpr()),
+                      UltExpr::create(p, getObjectEnd(candidates[end-1].first.get())));
+  }
+  bool mayBeTrue;
+  if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
+    return true;
+  if (!mayBeTrue)
+    return false;
+
+  if (end - begin == 1) {
+    rl.push_back(candidates[begin]);
+    return maxResolutions && rl.size() == maxResolutions;
+  }
+
+  unsigned mid = begin + (end - begin) / 2;
+  if (classifyCandidates(state, solver, p, candidates, begin, mid, 
+                         rl, maxResolutions, timer, timeout_us))
+    return true;
+  return classifyCandidates(state, solver, p, candidates, mid, end,
+                            rl, maxResolutions, timer, timeout_us);
+}
+
 bool AddressSpace::resolveOne(ExecutionState &state,
                               TimingSolver *solver,
                               ref<Expr> address,
@@ -97,63 +313,20 @@ bool AddressSpace::resolveOne(ExecutionState &state,
       }
     }
 
-    // didn't work, now we have to search
-       
-    MemoryMap::iterator oi = objects.upper_bound(&hack);
-    MemoryMap::iterator begin = objects.begin();
-    MemoryMap::iterator end = objects.end();
-      
-    MemoryMap::iterator start = oi;
-    while (oi!=begin) {
-      --oi;
-      const MemoryObject *mo = oi->first;
-        
-      bool mayBeTrue;
-      if (!solver->mayBeTrue(state, 
-                             mo->getBoundsCheckPointer(address), mayBeTrue))
-        return false;
-      if (mayBeTrue) {
-        result = *oi;
-        success = true;
-        return true;
-      } else {
-        bool mustBeTrue;
-        if (!solver->mustBeTrue(state, 
-                                UgeExpr::create(address, mo->getBaseExpr()),
-                                mustBeTrue))
-          return false;
-        if (mustBeTrue)
-          break;
-      }
-    }
-
-    // search forwards
-    for (oi=start; oi!=end; ++oi) {
-      const MemoryObject *mo = oi->first;
-
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state, 
-                              UltExpr::create(address, mo->getBaseExpr()),
-                              mustBeTrue))
-        return false;
-      if (mustBeTrue) {
-        break;
-      } else {
-        bool mayBeTrue;
-
-        if (!solver->mayBeTrue(state, 
-                               mo->getBoundsCheckPointer(address),
-                               mayBeTrue))
-          return false;
-        if (mayBeTrue) {
-          result = *oi;
-          success = true;
-          return true;
-        }
-      }
-    }
+    // didn't work, now we have to search the objects the pointer can
+    // reach
+    ResolutionList candidates, rl;
+    if (!getCandidateInterval(state, solver, address, example, objects,
+                              candidates))
+      return false;
+    if (classifyCandidates(state, solver, address, candidates, 
+                           0, candidates.size(), rl, 1, timer, 0) &&
+        rl.empty())
+      return false;
 
-    success = false;
+    success = !rl.empty();
+    if (success)
+      result = rl[0];
     return true;
   }
 }
@@ -173,111 +346,36 @@ bool AddressSpace::resolve(ExecutionState &state,
     TimerStatIncrementer timer(stats::resolveTime);
     uint64_t timeout_us = (uint64_t) (timeout*1000000.);
 
-    // XXX in general this isn't exactly what we want... for
-    // a multiple resolution case (or for example, a \in {b,c,0})
-    // we want to find the first object, find a cex assuming
-    // not the first, find a cex assuming not the second...
-    // etc.
-    
-    // XXX how do we smartly amortize the cost of checking to
-    // see if we need to keep searching up/down, in bad cases?
-    // maybe we don't care?
-    
-    // XXX we really just need a smart place to start (although
-    // if its a known solution then the code below is guaranteed
-    // to hit the fast path with exactly 2 queries). we could also
-    // just get this by inspection of the expr.
-    
+    // Start from a known solution: if the object it falls into is the only
+    // possible one we are done after a single extra query.
     ref<ConstantExpr> cex;
     if (!solver->getValue(state, p, cex))
       return true;
     uint64_t example = cex->getZExtValue();
     MemoryObject hack(example);
-    
-    MemoryMap::iterator oi = objects.upper_bound(&hack);
-    MemoryMap::iterator begin = objects.begin();
-    MemoryMap::iterator end = objects.end();
-      
-    MemoryMap::iterator start = oi;
-      
-    // XXX in the common case we can save one query if we ask
-    // mustBeTrue before mayBeTrue for the first result. easy
-    // to add I just want to have a nice symbolic test case first.
-      
-    // search backwards, start with one minus because this
-    // is the object that p *should* be within, which means we
-    // get write off the end with 4 queries (XXX can be better,
-    // no?)
-    while (oi!=begin) {
-      --oi;
-      const MemoryObject *mo = oi->first;
-      if (timeout_us && timeout_us < timer.check())
-        return true;
 
-      // XXX I think there is some query wasteage here?
-      ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
-      bool mayBeTrue;
-      if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
-        return true;
-      if (mayBeTrue) {
-        rl.push_back(*oi);
-        
-        // fast path check
-        unsigned size = rl.size();
-        if (size==1) {
-          bool mustBeTrue;
-          if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
-            return true;
-          if (mustBeTrue)
-            return false;
-        } else if (size==maxResolutions) {
+    if (const MemoryMap::value_type *res = objects.lookup_previous(&hack)) {
+      const MemoryObject *mo = res->first;
+      if (example - mo->address < mo->size) {
+        bool mustBeTrue;
+        if (!solver->mustBeTrue(state, mo->getBoundsCheckPointer(p), 
+                                mustBeTrue))
           return true;
+        if (mustBeTrue) {
+          rl.push_back(*res);
+          return false;
         }
       }
-        
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state, 
-                              UgeExpr::create(p, mo->getBaseExpr()),
-                              mustBeTrue))
-        return true;
-      if (mustBeTrue)
-        break;
     }
-    // search forwards
-    for (oi=start; oi!=end; ++oi) {
-      const MemoryObject *mo = oi->first;
-      if (timeout_us && timeout_us < timer.check())
-        return true;
 
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state, 
-                              UltExpr::create(p, mo->getBaseExpr()),
-                              mustBeTrue))
-        return true;
-      if (mustBeTrue)
-        break;
-      
-      // XXX I think there is some query wasteage here?
-      ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
-      bool mayBeTrue;
-      if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
-        return true;
-      if (mayBeTrue) {
-        rl.push_back(*oi);
-        
-        // fast path check
-        unsigned size = rl.size();
-        if (size==1) {
-          bool mustBeTrue;
-          if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
-            return true;
-          if (mustBeTrue)
-            return false;
-        } else if (size==maxResolutions) {
-          return true;
-        }
-      }
-    }
+    // Otherwise bound the objects the pointer can reach and classify them
+    // in groups, only splitting groups the pointer may fall into.
+    ResolutionList candidates;
+    if (!getCandidateInterval(state, solver, p, example, objects, candidates))
+      return true;
+    return classifyCandidates(state, solver, p, candidates, 
+                              0, candidates.size(), rl, 
+                              maxResolutions, timer, timeout_us);
   }
 
   return false;
@@ -319,6 +417,9 @@ bool AddressSpace::copyInConcretes() {
         } else {
           ObjectState *wos = getWriteable(mo, os);
           memcpy(wos->concreteStore, address, mo->size);
+          // Spans may cover the concrete bytes just replaced.
+          wos->clearSpans();
+          wos->rehash();
         }
       }
     }
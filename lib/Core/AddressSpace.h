@@ -15,6 +15,8 @@
 #include "klee/Expr.h"
 #include "klee/Internal/ADT/ImmutableMap.h"
 
+#include <set>
+
 namespace klee {
   class ExecutionState;
   class MemoryObject;
@@ -23,7 +25,10 @@ namespace klee {
 
   template<class T> class ref;
 
-  typedef std::pair<const MemoryObject*, const ObjectState*> ObjectPair;
+  /// An object and its state. The pair keeps the object alive, so it stays
+  /// valid even if the object is unbound from every address space while the
+  /// pair is in use.
+  typedef std::pair<ref<const MemoryObject>, const ObjectState*> ObjectPair;
   typedef std::vector<ObjectPair> ResolutionList;  
 
   /// Function object ordering MemoryObject's by address.
@@ -31,6 +36,8 @@ namespace klee {
     bool operator()(const MemoryObject *a, const MemoryObject *b) const;
   };
   
+  /// The keys are not counted references: every key is kept alive by the
+  /// ObjectState it maps to, which holds a reference to its object.
   typedef ImmutableMap<const MemoryObject*, ObjectHolder, MemoryObjectLT> MemoryMap;
   
   class AddressSpace {
@@ -38,8 +45,20 @@ namespace klee {
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// Sum of hashBinding() over the bindings not in dirtyObjects.
+    mutable uint64_t objectsHash;
+
+    /// Objects bound or made writeable since the last call to hash(), whose
+    /// contents may have changed since their binding was hashed.
+    mutable std::set<const MemoryObject*> dirtyObjects;
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace&); 
+
+    static uint64_t hashBinding(const MemoryObject *mo, const ObjectState *os);
+
+    /// Take the binding of \a mo out of objectsHash until the next hash().
+    void markDirty(const MemoryObject *mo);
     
   public:
     /// The MemoryObject -> ObjectState map that constitutes the
@@ -52,8 +71,10 @@ namespace klee {
     MemoryMap objects;
     
   public:
-    AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace() : cowKey(1), objectsHash(0) {}
+    AddressSpace(const AddressSpace &b) 
+      : cowKey(++b.cowKey), objectsHash(b.objectsHash), 
+        dirtyObjects(b.dirtyObjects), objects(b.objects) { }
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
@@ -97,9 +118,17 @@ namespace klee {
     /// Remove a binding from the address space.
     void unbindObject(const MemoryObject *mo);
 
+    /// Remove all bindings.
+    void clear();
+
     /// Lookup a binding from a MemoryObject.
     const ObjectState *findObject(const MemoryObject *mo) const;
 
+    /// Return a hash of the bindings and their contents. The hash is kept
+    /// up to date as objects are bound, unbound and made writeable, so only
+    /// the objects touched since the last call are hashed again.
+    uint64_t hash() const;
+
     /// \brief Obtain an ObjectState suitable for writing.
     ///
     /// This returns a writeable object state, creating a new copy of
@@ -30,6 +30,12 @@ namespace stats {
   /// The number of process forks.
   extern Statistic forks;
 
+  /// The number of executed SIMD instructions (with -instrument-simd).
+  extern Statistic simdInstructions;
+
+  /// The number of states terminated as redundant with an earlier state.
+  extern Statistic prunedStates;
+
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
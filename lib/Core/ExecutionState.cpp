@@ -15,6 +15,7 @@
 #include "klee/Internal/Module/KModule.h"
 
 #include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
 
 #include "Memory.h"
 
@@ -42,6 +43,7 @@ StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
     minDistToUncoveredOnReturn(0), varargs(0) {
   locals = new Cell[kf->numRegisters];
+  localsRefCount = new unsigned(1);
 }
 
 StackFrame::StackFrame(const StackFrame &s) 
@@ -49,15 +51,27 @@ StackFrame::StackFrame(const StackFrame &s)
     kf(s.kf),
     callPathNode(s.callPathNode),
     allocas(s.allocas),
+    locals(s.locals),
+    localsRefCount(s.localsRefCount),
     minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
     varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+  ++*localsRefCount;
 }
 
 StackFrame::~StackFrame() { 
-  delete[] locals; 
+  if (--*localsRefCount == 0) {
+    delete[] locals; 
+    delete localsRefCount;
+  }
+}
+
+void StackFrame::unshareLocals() {
+  Cell *copy = new Cell[kf->numRegisters];
+  for (unsigned i=0; i<kf->numRegisters; i++)
+    copy[i] = locals[i];
+  --*localsRefCount;
+  locals = copy;
+  localsRefCount = new unsigned(1);
 }
 
 /***/
@@ -73,7 +87,11 @@ ExecutionState::ExecutionState(KFunction *kf)
     instsSinceCovNew(0),
     coveredNew(false),
     forkDisabled(false),
-    ptreeNode(0) {
+    ptreeNode(0),
+    steppedInstructions(0),
+    resident(true),
+    evictedConstraintsHash(0),
+    madeExternalCall(false) {
   pushFrame(0, kf);
 }
 
@@ -82,7 +100,11 @@ ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
     underConstrained(false),
     constraints(assumptions),
     queryCost(0.),
-    ptreeNode(0) {
+    ptreeNode(0),
+    steppedInstructions(0),
+    resident(true),
+    evictedConstraintsHash(0),
+    madeExternalCall(false) {
 }
 
 ExecutionState::~ExecutionState() {
@@ -92,9 +114,12 @@ ExecutionState::~ExecutionState() {
 ExecutionState *ExecutionState::branch() {
   depth++;
 
+  // The new state starts with no covered lines, keep them out of the copy.
+  std::map<const std::string*, std::set<unsigned> > lines;
+  lines.swap(coveredLines);
   ExecutionState *falseState = new ExecutionState(*this);
+  coveredLines.swap(lines);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
 
   weight *= .5;
   falseState->weight -= weight;
@@ -108,12 +133,150 @@ void ExecutionState::pushFrame(KInstIterator caller, KFunction *kf) {
 
 void ExecutionState::popFrame() {
   StackFrame &sf = stack.back();
-  for (std::vector<const MemoryObject*>::iterator it = sf.allocas.begin(), 
+  for (std::vector< ref<const MemoryObject> >::iterator it = sf.allocas.begin(), 
          ie = sf.allocas.end(); it != ie; ++it)
-    addressSpace.unbindObject(*it);
+    addressSpace.unbindObject(it->get());
   stack.pop_back();
 }
 
+void ExecutionState::evict() {
+  evictedConstraintsHash = computePathConditionHash();
+  while (!stack.empty()) popFrame();
+  constraints = ConstraintManager();
+  addressSpace.clear();
+  symbolics.clear();
+  shadowObjects = MemoryMap();
+  watchpoint = ref<Expr>();
+  resident = false;
+}
+
+static uint64_t hashCombine(uint64_t h, uint64_t value) {
+  return (h ^ value) * 0x100000001B3ULL + (h >> 23);
+}
+
+static uint64_t hashMemory(uint64_t h, const MemoryMap &mm) {
+  for (MemoryMap::iterator it = mm.begin(), ie = mm.end(); it != ie; ++it) {
+    const ObjectState *os = it->second;
+    h = hashCombine(hashCombine(h, it->first->id), os->hash());
+  }
+  return h;
+}
+
+uint64_t ExecutionState::computeHash() const {
+  uint64_t h = hashCombine(pc->info->id, incomingBBIndex);
+
+  for (stack_ty::const_iterator it = stack.begin(), ie = stack.end(); 
+       it != ie; ++it) {
+    const StackFrame &sf = *it;
+    h = hashCombine(h, sf.caller ? sf.caller->info->id : 0);
+    h = hashCombine(h, (uintptr_t) sf.kf);
+    for (unsigned i = 0; i < sf.kf->numRegisters; i++) {
+      // Inline and ConstantExpr cells holding the same value hash alike.
+      const Cell &cell = sf.getLocal(i);
+      uint64_t value = 0;
+      if (cell.isConcrete())
+        value = hashCombine(cell.getConcreteValue(), cell.getConcreteWidth());
+      else if (!cell.isNull())
+        value = cell.getValue()->hash();
+      h = hashCombine(h, value);
+    }
+  }
+
+  h = hashCombine(h, addressSpace.hash());
+  h = hashMemory(h, shadowObjects);
+  h = hashCombine(h, symbolics.size());
+  h = hashCombine(h, computeConstraintsHash());
+  return hashCombine(h, constraints.size());
+}
+
+uint64_t ExecutionState::computeConstraintsHash() const {
+  // The constraints are hashed independently of their order, since the
+  // same path condition can be reached by taking branches in a different
+  // order.
+  uint64_t h = 0;
+  for (ConstraintManager::const_iterator it = constraints.begin(), 
+         ie = constraints.end(); it != ie; ++it)
+    h += hashCombine(0x9E3779B97F4A7C15ULL, (*it)->hash());
+  return h;
+}
+
+namespace {
+  /// Hashes expressions structurally, identifying symbolic arrays by their
+  /// position in the symbolics of a state and constant arrays by their
+  /// contents instead of by name.
+  class RenamedExprHasher {
+    std::map<const Array*, unsigned> symbolicIds;
+    std::map<const UpdateNode*, uint64_t> updateHashes;
+    ExprHashMap<uint64_t> exprHashes;
+
+    uint64_t hashArray(const Array *array) {
+      std::map<const Array*, unsigned>::iterator it = 
+        symbolicIds.find(array);
+      uint64_t h = hashCombine(array->size, 
+                               it == symbolicIds.end() ? 0 : it->second);
+      for (unsigned i = 0, e = array->constantValues.size(); i != e; ++i)
+        h = hashCombine(h, array->constantValues[i]->getZExtValue(8));
+      return h;
+    }
+
+    uint64_t hashUpdates(const UpdateNode *un) {
+      if (!un)
+        return 0;
+      std::map<const UpdateNode*, uint64_t>::iterator it = 
+        updateHashes.find(un);
+      if (it != updateHashes.end())
+        return it->second;
+
+      uint64_t h = hashCombine(hashUpdates(un->next), hash(un->index));
+      h = hashCombine(h, hash(un->value));
+      updateHashes.insert(std::make_pair(un, h));
+      return h;
+    }
+
+  public:
+    RenamedExprHasher(const std::vector< std::pair<ref<const MemoryObject>, 
+                                                   const Array*> > &symbolics) {
+      for (unsigned i = 0; i != symbolics.size(); ++i)
+        symbolicIds.insert(std::make_pair(symbolics[i].second, i + 1));
+    }
+
+    uint64_t hash(const ref<Expr> &e) {
+      if (isa<ConstantExpr>(e))
+        return e->hash();
+      ExprHashMap<uint64_t>::iterator it = exprHashes.find(e);
+      if (it != exprHashes.end())
+        return it->second;
+
+      // Fields other than the kind, width and kids (and the offset of an
+      // extract) are left out, which only makes the hash weaker.
+      uint64_t h = hashCombine(e->getKind(), e->getWidth());
+      if (ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+        h = hashCombine(h, hashArray(re->updates.root));
+        h = hashCombine(h, hashUpdates(re->updates.head));
+      } else if (ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+        h = hashCombine(h, ee->offset);
+      }
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        h = hashCombine(h, hash(e->getKid(i)));
+      exprHashes.insert(std::make_pair(e, h));
+      return h;
+    }
+  };
+}
+
+uint64_t ExecutionState::computePathConditionHash() const {
+  RenamedExprHasher hasher(symbolics);
+  uint64_t h = 0;
+  for (ConstraintManager::const_iterator it = constraints.begin(), 
+         ie = constraints.end(); it != ie; ++it)
+    h += hashCombine(0x9E3779B97F4A7C15ULL, hasher.hash(*it));
+  return h;
+}
+
+void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) { 
+  symbolics.push_back(std::make_pair(ref<const MemoryObject>(mo), array));
+}
+
 ///
 
 std::string ExecutionState::getFnAlias(std::string fn) {
@@ -203,22 +366,6 @@ bool ExecutionState::merge(const ExecutionState &b) {
     std::cerr << "]\n";
   }
 
-  // We cannot merge if either suffix contains floating point expressions
-  for (std::set< ref<Expr> >::iterator it = aSuffix.begin(), 
-         ie = aSuffix.end(); it != ie; ++it)
-    {
-      Expr::Kind kind = (*it)->getKind();
-      if (kind == Expr::FOrd1 || kind == Expr::FCmp)
-        return false;
-    }
-  for (std::set< ref<Expr> >::iterator it = bSuffix.begin(), 
-         ie = bSuffix.end(); it != ie; ++it)
-    {
-      Expr::Kind kind = (*it)->getKind();
-      if (kind == Expr::FOrd1 || kind == Expr::FCmp)
-        return false;
-    }
-
   // We cannot merge if addresses would resolve differently in the
   // states. This means:
   // 
@@ -283,13 +430,14 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      const Cell &av = af.getLocal(i);
+      const Cell &bv = bf.getLocal(i);
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        ref<Expr> value = SelectExpr::create(inA, av.getValue(), bv.getValue());
+        af.getLocalForWrite(i).setValue(value);
       }
     }
   }
@@ -315,7 +463,12 @@ bool ExecutionState::merge(const ExecutionState &b) {
   for (std::set< ref<Expr> >::iterator it = commonConstraints.begin(), 
          ie = commonConstraints.end(); it != ie; ++it)
     constraints.addConstraint(*it);
-  constraints.addConstraint(OrExpr::create(inA, inB));
+  // States that split at a single branch have complementary suffixes, in
+  // which case the disjunction is trivially true. Leaving it out keeps
+  // floating point comparisons out of the constraints where the solver
+  // could only approximate them.
+  if (inB != Expr::createIsZero(inA) && inA != Expr::createIsZero(inB))
+    constraints.addConstraint(OrExpr::create(inA, inB));
 
   return true;
 }
@@ -340,7 +493,7 @@ void ExecutionState::dumpStack(std::ostream &out) const {
 
       out << ai->getNameStr();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value; 
+      ref<Expr> value = sf.getLocal(sf.kf->getArgRegister(index++)).getValue(); 
       if (isa<ConstantExpr>(value))
         out << "=" << value;
     }
@@ -31,6 +31,7 @@
 #include "klee/Interpreter.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/BatchEvaluator.h"
 #include "klee/util/ExprPPrinter.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/GetElementPtrTypeIterator.h"
@@ -61,9 +62,13 @@
 #include "llvm/Target/TargetData.h"
 
 #include <cassert>
+#include <cfloat>
+#include <cmath>
 #include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <deque>
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -72,11 +77,17 @@
 #include <sys/mman.h>
 
 #include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <cxxabi.h>
 
 using namespace llvm;
 using namespace klee;
 
+extern cl::opt<double> CheckpointInterval;
+
 namespace {
   cl::opt<bool>
   DumpStatesOnHalt("dump-states-on-halt",
@@ -173,6 +184,10 @@ namespace {
   OnlyReplaySeeds("only-replay-seeds", 
                   cl::desc("Discard states that do not have a seed."));
  
+  cl::opt<bool>
+  Concolic("concolic",
+           cl::desc("Run the seed inputs one at a time, generating new inputs by negating the branches taken by each run (generational search)"));
+
   cl::opt<bool>
   OnlySeed("only-seed", 
            cl::desc("Stop execution after seeding is done without doing regular search."));
@@ -241,6 +256,51 @@ namespace {
             cl::desc("Inhibit forking at memory cap (vs. random terminate)"),
             cl::init(true));
 
+  cl::opt<bool>
+  SpillStates("spill-states",
+              cl::desc("At the memory cap, evict states and rebuild them by re-executing their path when selected (vs. terminate)"),
+              cl::init(false));
+
+  cl::opt<bool>
+  PruneRedundantStates("prune-redundant-states",
+                       cl::desc("Terminate states that enter a loop with the same pc, stack, memory and constraints as an earlier state"),
+                       cl::init(false));
+
+  cl::opt<std::string>
+  ResumeFrom("resume",
+             cl::desc("Continue the run recorded in the given checkpoint file (see -checkpoint-interval)"),
+             cl::init(""));
+
+  cl::opt<unsigned>
+  NumWorkers("num-workers",
+             cl::desc("Number of klee processes sharing this exploration, each run with a distinct -worker-id (default=1)"),
+             cl::init(1));
+
+  cl::opt<unsigned>
+  WorkerId("worker-id",
+           cl::desc("Index of this process among -num-workers (default=0)"),
+           cl::init(0));
+
+  cl::opt<unsigned>
+  WorkerSplitStates("worker-split-states",
+                    cl::desc("States per worker to reach before splitting the exploration (default=4)"),
+                    cl::init(4));
+
+  cl::opt<std::string>
+  WorkerDir("worker-dir",
+            cl::desc("Directory shared by the -num-workers processes, through which idle workers take states from busy ones"),
+            cl::init(""));
+
+  cl::opt<double>
+  WorkerPollInterval("worker-poll-interval",
+                     cl::desc("Seconds between checks of -worker-dir for idle workers (default=1)"),
+                     cl::init(1.));
+
+  cl::opt<bool>
+  ReplayPathPrefix("replay-path-prefix",
+                   cl::desc("Treat the -replay-path as a prefix and explore every path below it"),
+                   cl::init(false));
+
   cl::opt<bool>
   UseForkedSTP("use-forked-stp", 
                  cl::desc("Run STP in forked process"));
@@ -308,8 +368,124 @@ static const fltSemantics *TypeToFloatSemantics(const Type *Ty) {
   return &APFloat::PPCDoubleDouble;
 }
 
+/// Return the lane of at most 64 bits starting at the given bit offset of a
+/// concrete vector.
+static uint64_t getConcreteLane(const APInt &v, unsigned offset, unsigned bits) {
+  const uint64_t *words = v.getRawData();
+  unsigned w = offset / 64, b = offset % 64;
+  uint64_t value = words[w] >> b;
+  if (b + bits > 64)
+    value |= words[w + 1] << (64 - b);
+  return bits == 64 ? value : value & ((1ULL << bits) - 1);
+}
+
+/// Store a lane of at most 64 bits into a zero initialized vector.
+static void setConcreteLane(std::vector<uint64_t> &words, unsigned offset, 
+                            unsigned bits, uint64_t value) {
+  if (bits < 64)
+    value &= (1ULL << bits) - 1;
+  unsigned w = offset / 64, b = offset % 64;
+  words[w] |= value << b;
+  if (b + bits > 64)
+    words[w + 1] |= value >> (64 - b);
+}
+
+static ref<Expr> createConcreteVector(unsigned bits, 
+                                      const std::vector<uint64_t> &words) {
+  return klee::ConstantExpr::alloc(APInt(bits, words.size(), &words[0]));
+}
+
+// Host evaluation of single and double precision lanes. It is only used
+// where the host computes exactly what APFloat would: without excess
+// precision, and never for NaN results, whose payload may differ.
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+static const bool HostFloatIsExact = true;
+#else
+static const bool HostFloatIsExact = false;
+#endif
+
+typedef bool (*FConcreteHandler)(uint64_t left, uint64_t right,
+                                 unsigned width, uint64_t &result);
+
+static inline float bitsToFloat(uint64_t v) {
+  union { uint32_t i; float f; } u;
+  u.i = (uint32_t) v;
+  return u.f;
+}
+
+static inline uint64_t floatToBits(float f) {
+  union { uint32_t i; float f; } u;
+  u.f = f;
+  return u.i;
+}
+
+static inline double bitsToDouble(uint64_t v) {
+  union { uint64_t i; double d; } u;
+  u.i = v;
+  return u.d;
+}
+
+static inline uint64_t doubleToBits(double d) {
+  union { uint64_t i; double d; } u;
+  u.d = d;
+  return u.i;
+}
+
+#define CONCRETE_FBINOP(name, op)                                           \
+  static bool concreteF##name(uint64_t l, uint64_t r, unsigned w,           \
+                              uint64_t &res) {                              \
+    if (w == 32) {                                                          \
+      float f = bitsToFloat(l) op bitsToFloat(r);                           \
+      if (f != f)                                                           \
+        return false;                                                       \
+      res = floatToBits(f);                                                 \
+      return true;                                                          \
+    } else if (w == 64) {                                                   \
+      double d = bitsToDouble(l) op bitsToDouble(r);                        \
+      if (d != d)                                                           \
+        return false;                                                       \
+      res = doubleToBits(d);                                                \
+      return true;                                                          \
+    }                                                                       \
+    return false;                                                           \
+  }
+
+CONCRETE_FBINOP(Add, +)
+CONCRETE_FBINOP(Sub, -)
+CONCRETE_FBINOP(Mul, *)
+CONCRETE_FBINOP(Div, /)
+
+#undef CONCRETE_FBINOP
+
+/// Matches ConstantExpr::FSqrt, which also uses the host.
+static bool concreteFSqrt(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  if (w == 32)
+    res = floatToBits(sqrtf(bitsToFloat(l)));
+  else if (w == 64)
+    res = doubleToBits(sqrt(bitsToDouble(l)));
+  else
+    return false;
+  return true;
+}
+
 namespace {
 
+/// Append the lanes in \arg run, most significant first, to \arg pieces
+/// as a single constant and clear the run.
+static void packConstantLanes(std::vector<uint64_t> &run, unsigned bits,
+                              std::vector< ref<Expr> > &pieces) {
+  if (run.empty())
+    return;
+
+  unsigned n = run.size();
+  std::vector<uint64_t> words((bits*n + 63) / 64);
+  for (unsigned k = 0; k < n; ++k)
+    setConcreteLane(words, bits*(n-k-1), bits, run[k]);
+  pieces.push_back(createConcreteVector(bits*n, words));
+  run.clear();
+}
+
 class SIMDOperation {
 public:
   const Executor *Exec;
@@ -317,6 +493,38 @@ public:
 
   virtual ref<Expr> evalOne(const Type *tt, const Type *ft, ref<Expr> l, ref<Expr> r) = 0;
 
+  /// Evaluate one lane over concrete operands of at most 64 bits. Returns
+  /// false if the lane must take the general path.
+  virtual bool evalOneConcrete(const Type *tt, const Type *ft, unsigned width,
+                               uint64_t l, uint64_t r, uint64_t &res) {
+    return false;
+  }
+
+  /// Evaluate a vector operation over concrete operands directly on the
+  /// packed values. Returns null if some lane cannot be evaluated this way.
+  ref<Expr> evalConcrete(const VectorType *vtt, const VectorType *vft,
+                         klee::ConstantExpr *l, klee::ConstantExpr *r) {
+    const Type *fElTy = vft->getElementType();
+    const Type *tElTy = vtt->getElementType();
+    unsigned FromBits = Exec->getWidthForLLVMType(fElTy);
+    unsigned ToBits = Exec->getWidthForLLVMType(tElTy);
+    if (FromBits > 64 || ToBits > 64)
+      return 0;
+
+    unsigned ElemCount = vft->getNumElements();
+    const APInt &lv = l->getAPValue(), &rv = r->getAPValue();
+    std::vector<uint64_t> words((ToBits*ElemCount + 63) / 64);
+    for (unsigned i = 0; i < ElemCount; ++i) {
+      uint64_t res;
+      if (!evalOneConcrete(tElTy, fElTy, FromBits,
+                           getConcreteLane(lv, FromBits*i, FromBits),
+                           getConcreteLane(rv, FromBits*i, FromBits), res))
+        return 0;
+      setConcreteLane(words, ToBits*i, ToBits, res);
+    }
+    return createConcreteVector(ToBits*ElemCount, words);
+  }
+
   ref<Expr> eval(const Type *t, ref<Expr> src) {
     return eval(t, t, src);
   }
@@ -341,15 +549,48 @@ public:
    
       unsigned ElemCount = vft->getNumElements();
       assert(vtt->getNumElements() == ElemCount);
-      ref<Expr> *elems = new ref<Expr>[vft->getNumElements()];
-      for (unsigned i = 0; i < ElemCount; ++i)
-        elems[i] = evalOne(tElTy, fElTy,
-                           ExtractExpr::create(l, EltBits*(ElemCount-i-1), EltBits),
-                           ExtractExpr::create(r, EltBits*(ElemCount-i-1), EltBits));
-   
-      ref<Expr> Result = ConcatExpr::createN(ElemCount, elems);
-      delete[] elems;
-      return Result;
+
+      if (klee::ConstantExpr *lCE = dyn_cast<klee::ConstantExpr>(l))
+        if (klee::ConstantExpr *rCE = dyn_cast<klee::ConstantExpr>(r)) {
+          ref<Expr> Result = evalConcrete(vtt, vft, lCE, rCE);
+          if (!Result.isNull())
+            return Result;
+        }
+
+      std::vector< ref<Expr> > lLanes, rLanes;
+      getVectorLanes(l, EltBits, lLanes);
+      getVectorLanes(r, EltBits, rLanes);
+
+      // Lanes with concrete operands are evaluated natively and each run of
+      // them is packed into one constant, so that only the symbolic lanes
+      // build expressions. Pieces are collected most significant first.
+      unsigned ToBits = Exec->getWidthForLLVMType(tElTy);
+      bool native = EltBits <= 64 && ToBits <= 64;
+      std::vector< ref<Expr> > pieces;
+      std::vector<uint64_t> run;
+      for (unsigned i = ElemCount; i-- > 0;) {
+        klee::ConstantExpr *lCE = dyn_cast<klee::ConstantExpr>(lLanes[i]);
+        klee::ConstantExpr *rCE = dyn_cast<klee::ConstantExpr>(rLanes[i]);
+        uint64_t value;
+        if (native && lCE && rCE &&
+            evalOneConcrete(tElTy, fElTy, EltBits, lCE->getZExtValue(),
+                            rCE->getZExtValue(), value)) {
+          run.push_back(value);
+          continue;
+        }
+
+        ref<Expr> lane = evalOne(tElTy, fElTy, lLanes[i], rLanes[i]);
+        if (klee::ConstantExpr *CE = dyn_cast<klee::ConstantExpr>(lane))
+          if (native) {
+            run.push_back(CE->getZExtValue());
+            continue;
+          }
+        packConstantLanes(run, ToBits, pieces);
+        pieces.push_back(lane);
+      }
+      packConstantLanes(run, ToBits, pieces);
+
+      return ConcatExpr::createN(pieces.size(), &pieces[0]);
     } else
       return evalOne(tt, ft, l, r);
   }
@@ -359,24 +600,38 @@ class ISIMDOperation : public SIMDOperation {
 public:
   typedef ref<Expr> (*ExprCtor)(const ref<Expr> &l, const ref<Expr> &r);
   ExprCtor Ctor;
+  ConcreteHandler Handler;
 
-  ISIMDOperation(const Executor *Exec, ExprCtor Ctor) : SIMDOperation(Exec), Ctor(Ctor) {}
+  ISIMDOperation(const Executor *Exec, ExprCtor Ctor, ConcreteHandler Handler = 0) 
+    : SIMDOperation(Exec), Ctor(Ctor), Handler(Handler) {}
 
   ref<Expr> evalOne(const Type *tt, const Type *t, ref<Expr> l, ref<Expr> r) {
     return Ctor(l, r);
   }
+
+  bool evalOneConcrete(const Type *tt, const Type *t, unsigned width,
+                       uint64_t l, uint64_t r, uint64_t &res) {
+    return Handler && Handler(l, r, width, res);
+  }
 };
 
 class FSIMDOperation : public SIMDOperation {
 public:
   typedef ref<Expr> (*ExprCtor)(const ref<Expr> &l, const ref<Expr> &r, bool isIEEE);
   ExprCtor Ctor;
+  FConcreteHandler Handler;
 
-  FSIMDOperation(const Executor *Exec, ExprCtor Ctor) : SIMDOperation(Exec), Ctor(Ctor) {}
+  FSIMDOperation(const Executor *Exec, ExprCtor Ctor, FConcreteHandler Handler = 0) 
+    : SIMDOperation(Exec), Ctor(Ctor), Handler(Handler) {}
 
   ref<Expr> evalOne(const Type *tt, const Type *t, ref<Expr> l, ref<Expr> r) {
     return Ctor(l, r, t->isFP128Ty());
   }
+
+  bool evalOneConcrete(const Type *tt, const Type *t, unsigned width,
+                       uint64_t l, uint64_t r, uint64_t &res) {
+    return HostFloatIsExact && Handler && Handler(l, r, width, res);
+  }
 };
 
 class FCmpSIMDOperation : public SIMDOperation {
@@ -387,18 +642,51 @@ public:
   ref<Expr> evalOne(const Type *tt, const Type *t, ref<Expr> l, ref<Expr> r) {
     return FCmpExpr::create(l, r, pred, t->isFP128Ty());
   }
+
+  bool evalOneConcrete(const Type *tt, const Type *t, unsigned width,
+                       uint64_t l, uint64_t r, uint64_t &res) {
+    double a, b;
+    if (width == 32) {
+      a = bitsToFloat(l);
+      b = bitsToFloat(r);
+    } else if (width == 64) {
+      a = bitsToDouble(l);
+      b = bitsToDouble(r);
+    } else {
+      return false;
+    }
+
+    unsigned p = pred->getZExtValue(), outcome;
+    if (a != a || b != b)
+      outcome = FCmpExpr::UNO;
+    else if (a == b)
+      outcome = FCmpExpr::OEQ;
+    else if (a > b)
+      outcome = FCmpExpr::OGT;
+    else
+      outcome = FCmpExpr::OLT;
+    res = (p & outcome) != 0;
+    return true;
+  }
 };
 
 class FUnSIMDOperation : public SIMDOperation {
 public:
   typedef ref<Expr> (*ExprCtor)(const ref<Expr> &src, bool isIEEE);
   ExprCtor Ctor;
+  FConcreteHandler Handler;
 
-  FUnSIMDOperation(const Executor *Exec, ExprCtor Ctor) : SIMDOperation(Exec), Ctor(Ctor) {}
+  FUnSIMDOperation(const Executor *Exec, ExprCtor Ctor, FConcreteHandler Handler = 0) 
+    : SIMDOperation(Exec), Ctor(Ctor), Handler(Handler) {}
 
   ref<Expr> evalOne(const Type *tt, const Type *t, ref<Expr> l, ref<Expr> r) {
     return Ctor(l, t->isFP128Ty());
   }
+
+  bool evalOneConcrete(const Type *tt, const Type *t, unsigned width,
+                       uint64_t l, uint64_t r, uint64_t &res) {
+    return Handler && Handler(l, r, width, res);
+  }
 };
 
 class I2FSIMDOperation : public SIMDOperation {
@@ -444,6 +732,12 @@ Executor::Executor(const InterpreterOptions &opts,
     usingSeeds(0),
     atMemoryLimit(false),
     inhibitForking(false),
+    inWorkerPrefix(false),
+    rootState(0),
+    restoringState(0),
+    restorePosition(0),
+    restoreDiverged(false),
+    concolicCoveredNew(false),
     haltExecution(false),
     ivcEnabled(false),
     stpTimeout(MaxSTPTime != 0 && MaxInstructionTime != 0
@@ -716,7 +1010,7 @@ void Executor::initializeGlobals(ExecutionState &state) {
          e = m->global_end();
        i != e; ++i) {
     if (i->hasInitializer()) {
-      MemoryObject *mo = globalObjects.find(i)->second;
+      MemoryObject *mo = globalObjects.find(i)->second.get();
       const ObjectState *os = state.addressSpace.findObject(mo);
       assert(os);
       ObjectState *wos = state.addressSpace.getWriteable(mo, os);
@@ -734,12 +1028,37 @@ void Executor::branch(ExecutionState &state,
   unsigned N = conditions.size();
   assert(N);
 
+  if (&state == restoringState) {
+    // Follow the recorded split sequence below to find which result the
+    // state became.
+    unsigned index = 0;
+    for (unsigned i=1; i<N; ++i) {
+      if ((i & (i - 1)) != index)
+        continue;
+      if (restorePosition == restoreDecisions.size()) {
+        restoreDiverged = true;
+        break;
+      }
+      if (!restoreDecisions[restorePosition++])
+        index = i;
+    }
+    result.assign(N, NULL);
+    if (!restoreDiverged) {
+      result[index] = &state;
+      addConstraint(state, conditions[index]);
+    }
+    return;
+  }
+
   stats::forks += N-1;
 
   // XXX do proper balance or keep random?
+  // When states may be rebuilt, split deterministically (a binomial tree)
+  // so that the split sequence can be followed again.
   result.push_back(&state);
   for (unsigned i=1; i<N; ++i) {
-    ExecutionState *es = result[theRNG.getInt32() % i];
+    ExecutionState *es = 
+      rootState ? result[i & (i - 1)] : result[theRNG.getInt32() % i];
     ExecutionState *ns = es->branch();
     addedStates.insert(ns);
     result.push_back(ns);
@@ -785,7 +1104,7 @@ void Executor::branch(ExecutionState &state,
       seedMap[result[i]].push_back(*siit);
     }
 
-    if (OnlyReplaySeeds) {
+    if (OnlyReplaySeeds || Concolic) {
       for (unsigned i=0; i<N; ++i) {
         if (!seedMap.count(result[i])) {
           terminateState(*result[i]);
@@ -795,9 +1114,47 @@ void Executor::branch(ExecutionState &state,
     }
   }
 
-  for (unsigned i=0; i<N; ++i)
-    if (result[i])
+  for (unsigned i=0; i<N; ++i) {
+    if (result[i]) {
       addConstraint(*result[i], conditions[i]);
+      if (Concolic && !isa<ConstantExpr>(conditions[i]))
+        concolicBranches.push_back(concolicPath.size() - 1);
+    }
+  }
+}
+
+/// Evaluate \arg condition under the assignments of all \arg seeds in one
+/// batch. A single seed is evaluated on its own instead, which is cheaper
+/// than compiling the condition, and 0 is returned.
+static BatchEvaluator *evaluateSeeds(ref<Expr> condition,
+                                     const std::vector<SeedInfo> &seeds) {
+  if (seeds.size() < 2)
+    return 0;
+
+  std::vector<const Assignment*> assignments;
+  for (std::vector<SeedInfo>::const_iterator siit = seeds.begin(),
+         siie = seeds.end(); siit != siie; ++siit)
+    assignments.push_back(&siit->assignment);
+  BatchEvaluator *batch = new BatchEvaluator(condition);
+  batch->evaluate(assignments);
+  return batch;
+}
+
+/// Decide which way seed \arg i takes a branch on \arg condition, using the
+/// batch evaluation of the condition (if any) when it determined the seed
+/// and the solver otherwise.
+static bool seedTakesBranch(TimingSolver *solver, const ExecutionState &state,
+                            ref<Expr> condition, const BatchEvaluator *batch,
+                            unsigned i, SeedInfo &seed) {
+  if (batch && batch->isDetermined(i))
+    return batch->getValue(0, i);
+
+  ref<ConstantExpr> res;
+  bool success = 
+    solver->getValue(state, seed.assignment.evaluate(condition), res);
+  assert(success && "FIXME: Unhandled solver failure");
+  (void) success;
+  return res->isTrue();
 }
 
 Executor::StatePair 
@@ -807,6 +1164,23 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     seedMap.find(&current);
   bool isSeeding = it != seedMap.end();
 
+  // A concolic run follows its input: when the input decides the branch
+  // there is no need to ask the solver or to check the seed.
+  if (Concolic && isSeeding && it->second.size() == 1) {
+    ref<Expr> value = it->second[0].assignment.evaluate(condition);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+      bool branch = CE->isTrue();
+      if (!isa<ConstantExpr>(condition)) {
+        ref<Expr> taken = branch ? condition : Expr::createIsZero(condition);
+        addConstraint(current, taken);
+        concolicBranches.push_back(concolicPath.size() - 1);
+      }
+      if (!isInternal && pathWriter)
+        current.pathOS << (branch ? "1" : "0");
+      return branch ? StatePair(&current, 0) : StatePair(0, &current);
+    }
+  }
+
   if (!isSeeding && !isa<ConstantExpr>(condition) && 
       (MaxStaticForkPct!=1. || MaxStaticSolvePct != 1. ||
        MaxStaticCPForkPct!=1. || MaxStaticCPSolvePct != 1.) &&
@@ -846,8 +1220,26 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     return StatePair(0, 0);
   }
 
+  if (&current == restoringState) {
+    if (res==Solver::Unknown) {
+      if (restorePosition == restoreDecisions.size()) {
+        restoreDiverged = true;
+        return StatePair(0, 0);
+      }
+      if (restoreDecisions[restorePosition++]) {
+        res = Solver::True;
+        addConstraint(current, condition);
+      } else {
+        res = Solver::False;
+        addConstraint(current, Expr::createIsZero(condition));
+      }
+    }
+    return res==Solver::True ? StatePair(&current, 0) : StatePair(0, &current);
+  }
+
   if (!isSeeding) {
-    if (replayPath && !isInternal) {
+    if (replayPath && !isInternal &&
+        (!ReplayPathPrefix || replayPosition < replayPath->size())) {
       assert(replayPosition<replayPath->size() &&
              "ran out of branches in replay path mode");
       bool branch = (*replayPath)[replayPosition++];
@@ -898,18 +1290,15 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   // Fix branch in only-replay-seed mode, if we don't have both true
   // and false seeds.
   if (isSeeding && 
-      (current.forkDisabled || OnlyReplaySeeds) && 
+      (current.forkDisabled || OnlyReplaySeeds || Concolic) && 
       res == Solver::Unknown) {
     bool trueSeed=false, falseSeed=false;
+    BatchEvaluator *batch = evaluateSeeds(condition, it->second);
     // Is seed extension still ok here?
+    unsigned i = 0;
     for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
-      ref<ConstantExpr> res;
-      bool success = 
-        solver->getValue(current, siit->assignment.evaluate(condition), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res->isTrue()) {
+           siie = it->second.end(); siit != siie; ++siit, ++i) {
+      if (seedTakesBranch(solver, current, condition, batch, i, *siit)) {
         trueSeed = true;
       } else {
         falseSeed = true;
@@ -917,11 +1306,15 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       if (trueSeed && falseSeed)
         break;
     }
+    delete batch;
     if (!(trueSeed && falseSeed)) {
       assert(trueSeed || falseSeed);
       
       res = trueSeed ? Solver::True : Solver::False;
-      addConstraint(current, trueSeed ? condition : Expr::createIsZero(condition));
+      ref<Expr> taken = trueSeed ? condition : Expr::createIsZero(condition);
+      addConstraint(current, taken);
+      if (Concolic)
+        concolicBranches.push_back(concolicPath.size() - 1);
     }
   }
 
@@ -966,19 +1359,17 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       it->second.clear();
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
+      BatchEvaluator *batch = evaluateSeeds(condition, seeds);
+      unsigned i = 0;
       for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
-             siie = seeds.end(); siit != siie; ++siit) {
-        ref<ConstantExpr> res;
-        bool success = 
-          solver->getValue(current, siit->assignment.evaluate(condition), res);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (res->isTrue()) {
+             siie = seeds.end(); siit != siie; ++siit, ++i) {
+        if (seedTakesBranch(solver, current, condition, batch, i, *siit)) {
           trueSeeds.push_back(*siit);
         } else {
           falseSeeds.push_back(*siit);
         }
       }
+      delete batch;
       
       bool swapInfo = false;
       if (trueSeeds.empty()) {
@@ -1056,6 +1447,10 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   }
 
   state.addConstraint(condition);
+  // The inputs a concolic run generates must satisfy all of its
+  // constraints, not only its branches (klee_assume, concretizations).
+  if (Concolic && it != seedMap.end())
+    concolicPath.push_back(condition);
   if (ivcEnabled)
     doImpliedValueConcretization(state, condition, 
                                  ConstantExpr::alloc(1, Expr::Bool));
@@ -1107,18 +1502,18 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
   } else {
     unsigned index = vnumber;
     StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    return sf.getLocal(index);
   }
 }
 
 void Executor::bindLocal(KInstruction *target, ExecutionState &state, 
                          ref<Expr> value) {
-  getDestCell(state, target).value = value;
+  getDestCell(state, target).setValue(value);
 }
 
 void Executor::bindArgument(KFunction *kf, unsigned index, 
                             ExecutionState &state, ref<Expr> value) {
-  getArgumentCell(state, kf, index).value = value;
+  getArgumentCell(state, kf, index).setValue(value);
 }
 
 ref<Expr> Executor::toUnique(const ExecutionState &state, 
@@ -1225,6 +1620,7 @@ void Executor::stepInstruction(ExecutionState &state) {
     statsTracker->stepInstruction(state);
 
   ++stats::instructions;
+  ++state.steppedInstructions;
   state.prevPC = state.pc;
   ++state.pc;
 
@@ -1244,9 +1640,11 @@ void Executor::executeCall(ExecutionState &state,
       callExternalFunction(state, ki, f, arguments);
       break;
         
+      // SSE intrinsics handled here are listed as SSE_EXECUTED in
+      // SSEIntrinsics.def.
     case Intrinsic::x86_sse_sqrt_ps:
     case Intrinsic::sqrt: {
-      bindLocal(ki, state, FUnSIMDOperation(this, FSqrtExpr::create).eval(i->getType(), arguments[0]));
+      bindLocal(ki, state, FUnSIMDOperation(this, FSqrtExpr::create, concreteFSqrt).eval(i->getType(), arguments[0]));
       break;
     }
       // va_arg is handled by caller and intrinsic lowering, see comment for
@@ -1402,6 +1800,18 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
     PHINode *first = static_cast<PHINode*>(state.pc->inst);
     state.incomingBBIndex = first->getBasicBlockIndex(src);
   }
+
+  // Redundant states are looked for at backward branches, which is where
+  // the paths of a loop come back together. Rebuilt and seeded states are
+  // left alone, they retrace a path that has already been checked or must
+  // keep their inputs.
+  if (PruneRedundantStates && entry <= kf->basicBlockEntry[src] &&
+      &state != restoringState && !seedMap.count(&state)) {
+    if (!stateHashes.insert(state.computeHash()).second) {
+      ++stats::prunedStates;
+      terminateState(state);
+    }
+  }
 }
 
 void Executor::printFileLine(ExecutionState &state, KInstruction *ki) {
@@ -1468,8 +1878,294 @@ static inline const llvm::fltSemantics * fpWidthToSemantics(unsigned width) {
   }
 }
 
+static inline int64_t sextConcrete(uint64_t v, Expr::Width w) {
+  if (w == Expr::Int64)
+    return (int64_t) v;
+  return ((int64_t) (v << (64 - w))) >> (64 - w);
+}
+
+static inline bool isSignedDivOverflow(uint64_t l, int64_t sr, Expr::Width w) {
+  return sr == -1 && l == (1ULL << (w - 1));
+}
+
+// Concrete handlers, see KInstruction::concreteHandler. Division by zero,
+// signed division overflow and oversized shifts are left to the expression
+// builder.
+
+static bool concreteAdd(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  res = l + r;
+  return true;
+}
+
+static bool concreteSub(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  res = l - r;
+  return true;
+}
+
+static bool concreteMul(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  res = l * r;
+  return true;
+}
+
+static bool concreteUDiv(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  if (!r)
+    return false;
+  res = l / r;
+  return true;
+}
+
+static bool concreteSDiv(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  int64_t sr = sextConcrete(r, w);
+  if (!r || isSignedDivOverflow(l, sr, w))
+    return false;
+  res = (uint64_t) (sextConcrete(l, w) / sr);
+  return true;
+}
+
+static bool concreteURem(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  if (!r)
+    return false;
+  res = l % r;
+  return true;
+}
+
+static bool concreteSRem(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  int64_t sr = sextConcrete(r, w);
+  if (!r || isSignedDivOverflow(l, sr, w))
+    return false;
+  res = (uint64_t) (sextConcrete(l, w) % sr);
+  return true;
+}
+
+static bool concreteAnd(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  res = l & r;
+  return true;
+}
+
+static bool concreteOr(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  res = l | r;
+  return true;
+}
+
+static bool concreteXor(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  res = l ^ r;
+  return true;
+}
+
+static bool concreteShl(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  if (r >= w)
+    return false;
+  res = l << r;
+  return true;
+}
+
+static bool concreteLShr(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  if (r >= w)
+    return false;
+  res = l >> r;
+  return true;
+}
+
+static bool concreteAShr(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  if (r >= w)
+    return false;
+  res = (uint64_t) (sextConcrete(l, w) >> r);
+  return true;
+}
+
+#define CONCRETE_CMP(name, expr)                                             \
+  static bool concrete##name(uint64_t l, uint64_t r, unsigned w,            \
+                             uint64_t &res) {                               \
+    res = (expr);                                                           \
+    return true;                                                            \
+  }
+
+CONCRETE_CMP(Eq, l == r)
+CONCRETE_CMP(Ne, l != r)
+CONCRETE_CMP(Ugt, l > r)
+CONCRETE_CMP(Uge, l >= r)
+CONCRETE_CMP(Ult, l < r)
+CONCRETE_CMP(Ule, l <= r)
+CONCRETE_CMP(Sgt, sextConcrete(l, w) > sextConcrete(r, w))
+CONCRETE_CMP(Sge, sextConcrete(l, w) >= sextConcrete(r, w))
+CONCRETE_CMP(Slt, sextConcrete(l, w) < sextConcrete(r, w))
+CONCRETE_CMP(Sle, sextConcrete(l, w) <= sextConcrete(r, w))
+
+#undef CONCRETE_CMP
+
+/// Trunc, ZExt, IntToPtr and PtrToInt; the caller truncates the result.
+static bool concreteZExt(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  res = l;
+  return true;
+}
+
+static bool concreteSExt(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  res = (uint64_t) sextConcrete(l, w);
+  return true;
+}
+
+// Width-specialised handlers for operands of 8, 16, 32 and 64 bits, whose
+// sign extension and shift bound are fixed at compile time. S is the signed
+// type of the operand width.
+
+template <typename S>
+static bool concreteSDivN(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  S sl = (S) l, sr = (S) r;
+  if (!sr || (sr == -1 && sl == std::numeric_limits<S>::min()))
+    return false;
+  res = (uint64_t) (int64_t) (sl / sr);
+  return true;
+}
+
+template <typename S>
+static bool concreteSRemN(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  S sl = (S) l, sr = (S) r;
+  if (!sr || (sr == -1 && sl == std::numeric_limits<S>::min()))
+    return false;
+  res = (uint64_t) (int64_t) (sl % sr);
+  return true;
+}
+
+template <typename S>
+static bool concreteShlN(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  if (r >= sizeof(S) * 8)
+    return false;
+  res = l << r;
+  return true;
+}
+
+template <typename S>
+static bool concreteLShrN(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  if (r >= sizeof(S) * 8)
+    return false;
+  res = l >> r;
+  return true;
+}
+
+template <typename S>
+static bool concreteAShrN(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  if (r >= sizeof(S) * 8)
+    return false;
+  res = (uint64_t) (int64_t) ((S) l >> r);
+  return true;
+}
+
+#define CONCRETE_SCMP(name, op)                                              \
+  template <typename S>                                                     \
+  static bool concrete##name##N(uint64_t l, uint64_t r, unsigned w,         \
+                                uint64_t &res) {                            \
+    res = (S) l op (S) r;                                                   \
+    return true;                                                            \
+  }
+
+CONCRETE_SCMP(Sgt, >)
+CONCRETE_SCMP(Sge, >=)
+CONCRETE_SCMP(Slt, <)
+CONCRETE_SCMP(Sle, <=)
+
+#undef CONCRETE_SCMP
+
+template <typename S>
+static bool concreteSExtN(uint64_t l, uint64_t r, unsigned w, uint64_t &res) {
+  res = (uint64_t) (int64_t) (S) l;
+  return true;
+}
+
+/// Return the handler for \a i, whose first operand is \a w bits wide.
+static ConcreteHandler getConcreteHandler(const Instruction *i, unsigned w) {
+#define CONCRETE_BY_WIDTH(name)                                              \
+  switch (w) {                                                              \
+  case Expr::Int8: return concrete##name##N<int8_t>;                        \
+  case Expr::Int16: return concrete##name##N<int16_t>;                      \
+  case Expr::Int32: return concrete##name##N<int32_t>;                      \
+  case Expr::Int64: return concrete##name##N<int64_t>;                      \
+  default: return concrete##name;                                           \
+  }
+
+  switch (i->getOpcode()) {
+  case Instruction::Add: return concreteAdd;
+  case Instruction::Sub: return concreteSub;
+  case Instruction::Mul: return concreteMul;
+  case Instruction::UDiv: return concreteUDiv;
+  case Instruction::SDiv: CONCRETE_BY_WIDTH(SDiv)
+  case Instruction::URem: return concreteURem;
+  case Instruction::SRem: CONCRETE_BY_WIDTH(SRem)
+  case Instruction::And: return concreteAnd;
+  case Instruction::Or: return concreteOr;
+  case Instruction::Xor: return concreteXor;
+  case Instruction::Shl: CONCRETE_BY_WIDTH(Shl)
+  case Instruction::LShr: CONCRETE_BY_WIDTH(LShr)
+  case Instruction::AShr: CONCRETE_BY_WIDTH(AShr)
+
+  case Instruction::ICmp:
+    switch (cast<ICmpInst>(i)->getPredicate()) {
+    case ICmpInst::ICMP_EQ: return concreteEq;
+    case ICmpInst::ICMP_NE: return concreteNe;
+    case ICmpInst::ICMP_UGT: return concreteUgt;
+    case ICmpInst::ICMP_UGE: return concreteUge;
+    case ICmpInst::ICMP_ULT: return concreteUlt;
+    case ICmpInst::ICMP_ULE: return concreteUle;
+    case ICmpInst::ICMP_SGT: CONCRETE_BY_WIDTH(Sgt)
+    case ICmpInst::ICMP_SGE: CONCRETE_BY_WIDTH(Sge)
+    case ICmpInst::ICMP_SLT: CONCRETE_BY_WIDTH(Slt)
+    case ICmpInst::ICMP_SLE: CONCRETE_BY_WIDTH(Sle)
+    default: return 0;
+    }
+
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::IntToPtr:
+  case Instruction::PtrToInt:
+    return concreteZExt;
+  case Instruction::SExt:
+    CONCRETE_BY_WIDTH(SExt)
+
+  default:
+    return 0;
+  }
+
+#undef CONCRETE_BY_WIDTH
+}
+
+bool Executor::executeConcreteInstruction(ExecutionState &state,
+                                          KInstruction *ki) {
+  // Concrete module constants were decoded when the module was bound.
+  uint64_t left;
+  if (ki->constantMask & 1) {
+    left = ki->constantOperands[0];
+  } else {
+    const Cell &leftCell = eval(ki, 0, state);
+    if (!leftCell.isConcrete())
+      return false;
+    left = leftCell.getConcreteValue();
+  }
+
+  uint64_t right = 0;
+  if (ki->constantMask & 2) {
+    right = ki->constantOperands[1];
+  } else if (ki->inst->getNumOperands() > 1) {
+    const Cell &rightCell = eval(ki, 1, state);
+    if (!rightCell.isConcrete())
+      return false;
+    right = rightCell.getConcreteValue();
+  }
+
+  uint64_t result;
+  if (!ki->concreteHandler(left, right, ki->operandWidth, result))
+    return false;
+
+  getDestCell(state, ki).setConcrete(bits64::truncateToNBits(result,
+                                                             ki->width),
+                                     ki->width);
+  return true;
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
+
+  if (ki->concreteHandler && executeConcreteInstruction(state, ki))
+    return;
+
   switch (i->getOpcode()) {
     // Control flow
   case Instruction::Ret: {
@@ -1480,7 +2176,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
 
     if (!isVoidReturn) {
-      result = eval(ki, 0, state).value;
+      result = eval(ki, 0, state).getValue();
     }
     
     if (state.stack.size() <= 1) {
@@ -1560,7 +2256,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       // FIXME: Find a way that we don't have this hidden dependency.
       assert(bi->getCondition() == bi->getOperand(0) &&
              "Wrong operand index!");
-      ref<Expr> cond = eval(ki, 0, state).value;
+      ref<Expr> cond = eval(ki, 0, state).getValue();
       Executor::StatePair branches = fork(state, cond, false);
 
       // NOTE: There is a hidden dependency here, markBranchVisited
@@ -1579,7 +2275,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
   case Instruction::Switch: {
     SwitchInst *si = cast<SwitchInst>(i);
-    ref<Expr> cond = eval(ki, 0, state).value;
+    ref<Expr> cond = eval(ki, 0, state).getValue();
     unsigned cases = si->getNumCases();
     BasicBlock *bb = si->getParent();
 
@@ -1662,7 +2358,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     arguments.reserve(numArgs);
 
     for (unsigned j=0; j<numArgs; ++j)
-      arguments.push_back(eval(ki, j+1, state).value);
+      arguments.push_back(eval(ki, j+1, state).getValue());
 
     if (!f) {
       // special case the call with a bitcast case
@@ -1711,7 +2407,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     if (f) {
       executeCall(state, ki, f, arguments);
     } else {
-      ref<Expr> v = eval(ki, 0, state).value;
+      ref<Expr> v = eval(ki, 0, state).getValue();
 
       ExecutionState *free = &state;
       bool hasInvalid = false, first = true;
@@ -1752,8 +2448,10 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     break;
   }
   case Instruction::PHI: {
-    ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).value;
-    bindLocal(ki, state, result);
+    const Cell &incoming = eval(ki, state.incomingBBIndex * 2, state);
+    Cell &dest = getDestCell(state, ki);
+    if (&incoming != &dest)
+      dest = incoming;
     break;
   }
 
@@ -1762,9 +2460,16 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     SelectInst *SI = cast<SelectInst>(ki->inst);
     assert(SI->getCondition() == SI->getOperand(0) &&
            "Wrong operand index!");
-    ref<Expr> cond = eval(ki, 0, state).value;
-    ref<Expr> tExpr = eval(ki, 1, state).value;
-    ref<Expr> fExpr = eval(ki, 2, state).value;
+    const Cell &condCell = eval(ki, 0, state);
+    if (condCell.isConcrete() && condCell.getConcreteWidth() == Expr::Bool) {
+      getDestCell(state, ki) =
+        eval(ki, condCell.getConcreteValue() ? 1 : 2, state);
+      break;
+    }
+
+    ref<Expr> cond = eval(ki, 0, state).getValue();
+    ref<Expr> tExpr = eval(ki, 1, state).getValue();
+    ref<Expr> fExpr = eval(ki, 2, state).getValue();
 
 #if 0
     Expr::Kind condKind = cond->getKind();
@@ -1790,102 +2495,102 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Arithmetic / logical
 
   case Instruction::Add: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, ISIMDOperation(this, AddExpr::create).eval(i->getType(), left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, ISIMDOperation(this, AddExpr::create, concreteAdd).eval(i->getType(), left, right));
     break;
   }
 
   case Instruction::Sub: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, ISIMDOperation(this, SubExpr::create).eval(i->getType(), left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, ISIMDOperation(this, SubExpr::create, concreteSub).eval(i->getType(), left, right));
     break;
   }
  
   case Instruction::Mul: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, ISIMDOperation(this, MulExpr::create).eval(i->getType(), left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, ISIMDOperation(this, MulExpr::create, concreteMul).eval(i->getType(), left, right));
     break;
   }
 
   case Instruction::UDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ISIMDOperation(this, UDivExpr::create).eval(i->getType(), left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = ISIMDOperation(this, UDivExpr::create, concreteUDiv).eval(i->getType(), left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::SDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ISIMDOperation(this, SDivExpr::create).eval(i->getType(), left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = ISIMDOperation(this, SDivExpr::create, concreteSDiv).eval(i->getType(), left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::URem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ISIMDOperation(this, URemExpr::create).eval(i->getType(), left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = ISIMDOperation(this, URemExpr::create, concreteURem).eval(i->getType(), left, right);
     bindLocal(ki, state, result);
     break;
   }
  
   case Instruction::SRem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ISIMDOperation(this, SRemExpr::create).eval(i->getType(), left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = ISIMDOperation(this, SRemExpr::create, concreteSRem).eval(i->getType(), left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::And: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = AndExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Or: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = OrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Xor: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = XorExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Shl: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ISIMDOperation(this, ShlExpr::create).eval(i->getType(), left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = ISIMDOperation(this, ShlExpr::create, concreteShl).eval(i->getType(), left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::LShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ISIMDOperation(this, LShrExpr::create).eval(i->getType(), left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = ISIMDOperation(this, LShrExpr::create, concreteLShr).eval(i->getType(), left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::AShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ISIMDOperation(this, AShrExpr::create).eval(i->getType(), left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = ISIMDOperation(this, AShrExpr::create, concreteAShr).eval(i->getType(), left, right);
     bindLocal(ki, state, result);
     break;
   }
@@ -1898,81 +2603,81 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
  
     switch(ii->getPredicate()) {
     case ICmpInst::ICMP_EQ: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, EqExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, EqExpr::create, concreteEq).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_NE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, NeExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, NeExpr::create, concreteNe).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_UGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, UgtExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, UgtExpr::create, concreteUgt).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state,result);
       break;
     }
 
     case ICmpInst::ICMP_UGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, UgeExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, UgeExpr::create, concreteUge).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_ULT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, UltExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, UltExpr::create, concreteUlt).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_ULE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, UleExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, UleExpr::create, concreteUle).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, SgtExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, SgtExpr::create, concreteSgt).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, SgeExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, SgeExpr::create, concreteSge).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SLT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, SltExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, SltExpr::create, concreteSlt).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SLE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = ISIMDOperation(this, SleExpr::create).eval(i->getType(), left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = ISIMDOperation(this, SleExpr::create, concreteSle).eval(i->getType(), ii->getOperand(0)->getType(), left, right);
       bindLocal(ki, state, result);
       break;
     }
@@ -1996,7 +2701,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
     ref<Expr> size = Expr::createPointer(elementSize);
     if (ai->isArrayAllocation()) {
-      ref<Expr> count = eval(ki, 0, state).value;
+      ref<Expr> count = eval(ki, 0, state).getValue();
       count = Expr::createCoerceToPointerType(count);
       size = MulExpr::create(size, count);
     }
@@ -2006,32 +2711,32 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 #if (LLVM_VERSION_MAJOR == 2 && LLVM_VERSION_MINOR < 7)
   case Instruction::Free: {
-    executeFree(state, eval(ki, 0, state).value);
+    executeFree(state, eval(ki, 0, state).getValue());
     break;
   }
 #endif
 
   case Instruction::Load: {
-    ref<Expr> base = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 0, state).getValue();
     executeMemoryOperation(state, false, base, 0, ki);
     break;
   }
   case Instruction::Store: {
-    ref<Expr> base = eval(ki, 1, state).value;
-    ref<Expr> value = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 1, state).getValue();
+    ref<Expr> value = eval(ki, 0, state).getValue();
     executeMemoryOperation(state, true, base, value, 0);
     break;
   }
 
   case Instruction::GetElementPtr: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
-    ref<Expr> base = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 0, state).getValue();
 
     for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
            it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
          it != ie; ++it) {
       uint64_t elementSize = it->second;
-      ref<Expr> index = eval(ki, it->first, state).value;
+      ref<Expr> index = eval(ki, it->first, state).getValue();
       base = AddExpr::create(base,
                              MulExpr::create(Expr::createCoerceToPointerType(index),
                                              Expr::createPointer(elementSize)));
@@ -2045,82 +2750,76 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Conversion
   case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
+    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).getValue(),
                                            0,
-                                           getWidthForLLVMType(ci->getType()));
+                                           ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).getValue(),
+                                        ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).getValue(),
+                                        ki->width);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
+    Expr::Width pType = ki->width;
+    ref<Expr> arg = eval(ki, 0, state).getValue();
     bindLocal(ki, state, ZExtExpr::create(arg, pType));
     break;
   } 
   case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
+    Expr::Width iType = ki->width;
+    ref<Expr> arg = eval(ki, 0, state).getValue();
     bindLocal(ki, state, ZExtExpr::create(arg, iType));
     break;
   }
 
   case Instruction::BitCast: {
-    ref<Expr> result = eval(ki, 0, state).value;
-    bindLocal(ki, state, result);
+    getDestCell(state, ki) = eval(ki, 0, state);
     break;
   }
 
     // Floating point instructions
 
   case Instruction::FAdd: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right  = eval(ki, 1, state).value;
-    bindLocal(ki, state, FSIMDOperation(this, FAddExpr::create).eval(i->getType(), left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right  = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, FSIMDOperation(this, FAddExpr::create, concreteFAdd).eval(i->getType(), left, right));
     break;
   }
 
   case Instruction::FSub: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right  = eval(ki, 1, state).value;
-    bindLocal(ki, state, FSIMDOperation(this, FSubExpr::create).eval(i->getType(), left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right  = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, FSIMDOperation(this, FSubExpr::create, concreteFSub).eval(i->getType(), left, right));
     break;
   }
 
   case Instruction::FMul: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right  = eval(ki, 1, state).value;
-    bindLocal(ki, state, FSIMDOperation(this, FMulExpr::create).eval(i->getType(), left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right  = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, FSIMDOperation(this, FMulExpr::create, concreteFMul).eval(i->getType(), left, right));
     break;
   }
 
   case Instruction::FDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right  = eval(ki, 1, state).value;
-    bindLocal(ki, state, FSIMDOperation(this, FDivExpr::create).eval(i->getType(), left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right  = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, FSIMDOperation(this, FDivExpr::create, concreteFDiv).eval(i->getType(), left, right));
     break;
   }
 
   case Instruction::FRem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right  = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right  = eval(ki, 1, state).getValue();
     bindLocal(ki, state, FSIMDOperation(this, FRemExpr::create).eval(i->getType(), left, right));
     break;
   }
@@ -2128,7 +2827,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPTrunc:
   case Instruction::FPExt: {
     CastInst *ci = cast<CastInst>(i);
-    ref<Expr> arg = eval(ki, 0, state).value;
+    ref<Expr> arg = eval(ki, 0, state).getValue();
     const llvm::Type *type = i->getType();
     const fltSemantics *sem = TypeToFloatSemantics(type);
     bindLocal(ki, state,
@@ -2140,7 +2839,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
   case Instruction::FPToUI:
   case Instruction::FPToSI: {
-    ref<Expr> arg = eval(ki, 0, state).value;
+    ref<Expr> arg = eval(ki, 0, state).getValue();
     const llvm::Type *type = i->getType();
     bindLocal(ki, state, F2ISIMDOperation(this,
        (i->getOpcode() == Instruction::FPToUI
@@ -2151,7 +2850,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
   case Instruction::UIToFP:
   case Instruction::SIToFP: {
-    ref<Expr> arg = eval(ki, 0, state).value;
+    ref<Expr> arg = eval(ki, 0, state).getValue();
     const llvm::Type *type = i->getType();
     bindLocal(ki, state, I2FSIMDOperation(this,
        (i->getOpcode() == Instruction::UIToFP
@@ -2162,8 +2861,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
   case Instruction::FCmp: {
     FCmpInst *fi = cast<FCmpInst>(i);
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
 
     ref<Expr> Result = FCmpSIMDOperation(this, fi->getPredicate()).eval(i->getType(), fi->getOperand(0)->getType(), left, right);
     bindLocal(ki, state, Result);
@@ -2174,40 +2873,72 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Unhandled
   case Instruction::ExtractElement: {
     ExtractElementInst *eei = cast<ExtractElementInst>(i);
-    ref<Expr> vec = eval(ki, 0, state).value;
-    ref<Expr> idx = eval(ki, 1, state).value;
-
-    assert(isa<ConstantExpr>(idx) && "symbolic index unsupported");
-    ConstantExpr *cIdx = cast<ConstantExpr>(idx);
-    uint64_t iIdx = cIdx->getZExtValue();
+    ref<Expr> vec = eval(ki, 0, state).getValue();
+    ref<Expr> idx = eval(ki, 1, state).getValue();
 
     const llvm::VectorType *vt = eei->getVectorOperandType();
     unsigned EltBits = getWidthForLLVMType(vt->getElementType());
+    unsigned ElemCount = vt->getNumElements();
 
-    ref<Expr> Result = ExtractExpr::create(vec, EltBits*iIdx, EltBits);
+    ref<Expr> Result;
+    if (ConstantExpr *cIdx = dyn_cast<ConstantExpr>(idx)) {
+      uint64_t iIdx = cIdx->getZExtValue();
+      // An out of range index gives an undefined value.
+      Result = iIdx < ElemCount 
+        ? ExtractExpr::create(vec, EltBits*iIdx, EltBits)
+        : ConstantExpr::alloc(0, EltBits);
+    } else {
+      // Select among the lanes rather than forking on the index, so that
+      // one state covers every index value.
+      std::vector< ref<Expr> > lanes;
+      getVectorLanes(vec, EltBits, lanes);
+      Result = lanes[ElemCount-1];
+      for (unsigned j = ElemCount-1; j-- > 0; )
+        Result = SelectExpr::create(EqExpr::create(idx, 
+                                                   ConstantExpr::alloc(j, idx->getWidth())),
+                                    lanes[j], Result);
+    }
 
     bindLocal(ki, state, Result);
     break;
   }
   case Instruction::InsertElement: {
     InsertElementInst *iei = cast<InsertElementInst>(i);
-    ref<Expr> vec = eval(ki, 0, state).value;
-    ref<Expr> newElt = eval(ki, 1, state).value;
-    ref<Expr> idx = eval(ki, 2, state).value;
-
-    assert(isa<ConstantExpr>(idx) && "symbolic index unsupported");
-    ConstantExpr *cIdx = cast<ConstantExpr>(idx);
-    uint64_t iIdx = cIdx->getZExtValue();
+    ref<Expr> vec = eval(ki, 0, state).getValue();
+    ref<Expr> newElt = eval(ki, 1, state).getValue();
+    ref<Expr> idx = eval(ki, 2, state).getValue();
 
     const llvm::VectorType *vt = iei->getType();
     unsigned EltBits = getWidthForLLVMType(vt->getElementType());
 
     unsigned ElemCount = vt->getNumElements();
+    ConstantExpr *cIdx = dyn_cast<ConstantExpr>(idx);
+    uint64_t iIdx = cIdx ? cIdx->getZExtValue() : 0;
+    ConstantExpr *cVec = dyn_cast<ConstantExpr>(vec);
+    ConstantExpr *cElt = dyn_cast<ConstantExpr>(newElt);
+    if (cIdx && cVec && cElt && EltBits <= 64) {
+      std::vector<uint64_t> words((EltBits*ElemCount + 63) / 64);
+      for (unsigned i = 0; i < ElemCount; ++i)
+        setConcreteLane(words, EltBits*i, EltBits, i == iIdx 
+                        ? cElt->getZExtValue() 
+                        : getConcreteLane(cVec->getAPValue(), EltBits*i, EltBits));
+      bindLocal(ki, state, createConcreteVector(EltBits*ElemCount, words));
+      break;
+    }
+
+    std::vector< ref<Expr> > lanes;
+    getVectorLanes(vec, EltBits, lanes);
+
     ref<Expr> *elems = new ref<Expr>[vt->getNumElements()];
-    for (unsigned i = 0; i < ElemCount; ++i)
-      elems[ElemCount-i-1] = i == iIdx
-                             ? newElt
-                             : ExtractExpr::create(vec, EltBits*i, EltBits);
+    for (unsigned i = 0; i < ElemCount; ++i) {
+      ref<Expr> &el = elems[ElemCount-i-1];
+      if (cIdx)
+        el = i == iIdx ? newElt : lanes[i];
+      else // Guard each lane by the index, one state covers every value.
+        el = SelectExpr::create(EqExpr::create(idx, 
+                                               ConstantExpr::alloc(i, idx->getWidth())),
+                                newElt, lanes[i]);
+    }
 
     ref<Expr> Result = ConcatExpr::createN(ElemCount, elems);
     delete[] elems;
@@ -2218,12 +2949,37 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::ShuffleVector: {
     ShuffleVectorInst *svi = cast<ShuffleVectorInst>(i);
 
-    ref<Expr> vec1 = eval(ki, 0, state).value;
-    ref<Expr> vec2 = eval(ki, 1, state).value;
+    ref<Expr> vec1 = eval(ki, 0, state).getValue();
+    ref<Expr> vec2 = eval(ki, 1, state).getValue();
     const llvm::VectorType *vt = svi->getType();
     unsigned EltBits = getWidthForLLVMType(vt->getElementType());
 
     unsigned ElemCount = vt->getNumElements();
+    // The mask indexes the lanes of both operands, which may have a
+    // different number of lanes than the result.
+    unsigned SrcCount = vec1->getWidth() / EltBits;
+    ConstantExpr *cVec1 = dyn_cast<ConstantExpr>(vec1);
+    ConstantExpr *cVec2 = dyn_cast<ConstantExpr>(vec2);
+    if (cVec1 && cVec2 && EltBits <= 64) {
+      std::vector<uint64_t> words((EltBits*ElemCount + 63) / 64);
+      for (unsigned i = 0; i < ElemCount; ++i) {
+        int MaskValI = svi->getMaskValue(i);
+        if (MaskValI < 0)
+          continue;
+        unsigned MaskVal = (unsigned) MaskValI;
+        uint64_t value = MaskVal < SrcCount
+          ? getConcreteLane(cVec1->getAPValue(), EltBits*MaskVal, EltBits)
+          : getConcreteLane(cVec2->getAPValue(), EltBits*(MaskVal-SrcCount), EltBits);
+        setConcreteLane(words, EltBits*i, EltBits, value);
+      }
+      bindLocal(ki, state, createConcreteVector(EltBits*ElemCount, words));
+      break;
+    }
+
+    std::vector< ref<Expr> > lanes1, lanes2;
+    getVectorLanes(vec1, EltBits, lanes1);
+    getVectorLanes(vec2, EltBits, lanes2);
+
     ref<Expr> *elems = new ref<Expr>[vt->getNumElements()];
     for (unsigned i = 0; i < ElemCount; ++i) {
       int MaskValI = svi->getMaskValue(i);
@@ -2232,10 +2988,10 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 	el = ConstantExpr::alloc(0, EltBits);
       else {
 	unsigned MaskVal = (unsigned) MaskValI;
-	if (MaskVal < ElemCount)
-          el = ExtractExpr::create(vec1, EltBits*MaskVal, EltBits);
+	if (MaskVal < SrcCount)
+          el = lanes1[MaskVal];
         else
-	  el = ExtractExpr::create(vec2, EltBits*(MaskVal-ElemCount), EltBits);
+	  el = lanes2[MaskVal-SrcCount];
       }
     }
 
@@ -2248,8 +3004,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::InsertValue: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
-    ref<Expr> val = eval(ki, 1, state).value;
+    ref<Expr> agg = eval(ki, 0, state).getValue();
+    ref<Expr> val = eval(ki, 1, state).getValue();
 
     ref<Expr> l = NULL, r = NULL;
     unsigned lOffset = kgepi->offset*8, rOffset = kgepi->offset*8 + val->getWidth();
@@ -2275,7 +3031,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::ExtractValue: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
+    ref<Expr> agg = eval(ki, 0, state).getValue();
 
     ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, getWidthForLLVMType(i->getType()));
 
@@ -2351,6 +3107,31 @@ void Executor::computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie) {
 void Executor::bindInstructionConstants(KInstruction *KI) {
   KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(KI);
 
+  // Vector operations are split lane-wise by the SIMD helpers, and wider
+  // results cannot be held inline.
+  if (!isa<VectorType>(KI->inst->getType()) &&
+      KI->width && KI->width <= Expr::Int64 && KI->inst->getNumOperands()) {
+    const Type *opType = KI->inst->getOperand(0)->getType();
+    if (opType->isSized())
+      KI->operandWidth = kmodule->targetData->getTypeSizeInBits(opType);
+    if (KI->operandWidth && KI->operandWidth <= Expr::Int64)
+      KI->concreteHandler = getConcreteHandler(KI->inst, KI->operandWidth);
+
+    if (KI->concreteHandler) {
+      for (unsigned j = 0, e = std::min(KI->inst->getNumOperands(), 2U); 
+           j != e; ++j) {
+        int vnumber = KI->operands[j];
+        if (vnumber >= -1)
+          continue;
+        const Cell &c = kmodule->constantTable[-vnumber - 2];
+        if (c.isConcrete()) {
+          KI->constantMask |= 1 << j;
+          KI->constantOperands[j] = c.getConcreteValue();
+        }
+      }
+    }
+  }
+
   if (GetElementPtrInst *gepi = dyn_cast<GetElementPtrInst>(KI->inst)) {
     computeOffsets(kgepi, gep_type_begin(gepi), gep_type_end(gepi));
   } else if (InsertValueInst *ivi = dyn_cast<InsertValueInst>(KI->inst)) {
@@ -2363,18 +3144,315 @@ void Executor::bindInstructionConstants(KInstruction *KI) {
 }
 
 void Executor::bindModuleConstants() {
+  kmodule->constantTable = new Cell[kmodule->constants.size()];
+  for (unsigned i=0; i<kmodule->constants.size(); ++i) {
+    Cell &c = kmodule->constantTable[i];
+    c.setValue(evalConstant(kmodule->constants[i]));
+  }
+
+  // Instruction constants refer to the constant table.
   for (std::vector<KFunction*>::iterator it = kmodule->functions.begin(), 
          ie = kmodule->functions.end(); it != ie; ++it) {
     KFunction *kf = *it;
     for (unsigned i=0; i<kf->numInstructions; ++i)
       bindInstructionConstants(kf->instructions[i]);
   }
+}
 
-  kmodule->constantTable = new Cell[kmodule->constants.size()];
-  for (unsigned i=0; i<kmodule->constants.size(); ++i) {
-    Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
+void Executor::splitAmongWorkers() {
+  if (WorkerId >= NumWorkers)
+    klee_error("invalid -worker-id %u (expected less than -num-workers %u)",
+               (unsigned) WorkerId, (unsigned) NumWorkers);
+
+  // Every worker runs the same prefix, so it must not depend on timing or
+  // allocation addresses: always step the leftmost state of the process
+  // tree.
+  inWorkerPrefix = true;
+  unsigned target = NumWorkers * std::max(1U, (unsigned) WorkerSplitStates);
+  while (!states.empty() && states.size() < target && !haltExecution) {
+    PTree::Node *n = processTree->root;
+    while (!n->data)
+      n = n->left ? n->left : n->right;
+
+    ExecutionState &state = *n->data;
+    KInstruction *ki = state.pc;
+    stepInstruction(state);
+
+    executeInstruction(state, ki);
+    processTimers(&state, MaxInstructionTime);
+    updateStates(&state);
+  }
+  inWorkerPrefix = false;
+
+  // Deal the states out in process tree order.
+  std::vector<ExecutionState*> ordered;
+  std::vector<PTree::Node*> stack;
+  if (!states.empty())
+    stack.push_back(processTree->root);
+  while (!stack.empty()) {
+    PTree::Node *n = stack.back();
+    stack.pop_back();
+    if (n->data) {
+      ordered.push_back(n->data);
+    } else {
+      if (n->right) stack.push_back(n->right);
+      if (n->left) stack.push_back(n->left);
+    }
+  }
+
+  for (unsigned i = 0; i < ordered.size(); ++i)
+    if (i % NumWorkers != WorkerId)
+      terminateState(*ordered[i]);
+  updateStates(0);
+
+  klee_message("worker %u of %u: exploring %u of %u states",
+               (unsigned) WorkerId, (unsigned) NumWorkers,
+               (unsigned) states.size(), (unsigned) ordered.size());
+}
+
+static std::string getWorkerFile(const char *kind, unsigned id) {
+  return WorkerDir + "/" + kind + "." + utostr(id);
+}
+
+static bool fileExists(const std::string &path) {
+  return access(path.c_str(), F_OK) == 0;
+}
+
+static bool createFile(const std::string &path) {
+  std::ofstream os(path.c_str());
+  return os.good();
+}
+
+void Executor::serveWorkRequests() {
+  // States that made external calls cannot be rebuilt elsewhere.
+  std::vector<ExecutionState*> movable;
+  for (std::set<ExecutionState*>::iterator it = states.begin(), 
+         ie = states.end(); it != ie; ++it)
+    if (!(*it)->madeExternalCall)
+      movable.push_back(*it);
+
+  for (unsigned id = 0; id < NumWorkers && movable.size() >= 2; ++id) {
+    if (id == WorkerId)
+      continue;
+
+    // The rename is atomic, so each request is claimed by one worker.
+    std::string request = getWorkerFile("request", id);
+    std::string taken = request + ".taken";
+    if (rename(request.c_str(), taken.c_str()) != 0)
+      continue;
+
+    std::string work = getWorkerFile("work", id);
+    std::string tmpWork = work + ".tmp";
+    unsigned numGiven = movable.size() / 2;
+    std::ofstream os(tmpWork.c_str());
+    for (unsigned i = movable.size() - numGiven; i < movable.size(); ++i)
+      writeStateRecord(os, *movable[i]);
+    os.close();
+    if (!os.good() || rename(tmpWork.c_str(), work.c_str()) != 0) {
+      klee_warning("unable to write states for worker %u: %s", id,
+                   work.c_str());
+      unlink(tmpWork.c_str());
+      rename(taken.c_str(), request.c_str());
+      return;
+    }
+
+    for (unsigned i = movable.size() - numGiven; i < movable.size(); ++i)
+      terminateState(*movable[i]);
+    movable.resize(movable.size() - numGiven);
+    unlink(taken.c_str());
+    klee_message("worker %u: gave %u states to worker %u",
+                 (unsigned) WorkerId, numGiven, id);
+  }
+
+  updateStates(0);
+}
+
+bool Executor::requestWork() {
+  std::string request = getWorkerFile("request", WorkerId);
+  std::string work = getWorkerFile("work", WorkerId);
+  if (!createFile(request)) {
+    klee_warning("unable to request states: %s", request.c_str());
+    return false;
+  }
+
+  std::map<unsigned, KInstruction**> instructions;
+  getInstructionsByID(instructions);
+
+  while (!haltExecution) {
+    if (fileExists(work)) {
+      std::ifstream is(work.c_str());
+      unlink(work.c_str());
+
+      // The process tree emptied with the last state.
+      delete processTree;
+      processTree = new PTree(0);
+
+      std::set<ExecutionState*> newStates;
+      std::string kind;
+      while (is >> kind) {
+        ExecutionState *es = 0;
+        if (kind == "state")
+          es = readStateRecord(is, instructions);
+        if (!es) {
+          klee_warning("invalid states from %s", work.c_str());
+          break;
+        }
+        newStates.insert(es);
+      }
+      pruneProcessTree();
+
+      states.insert(newStates.begin(), newStates.end());
+      searcher->update(0, newStates, std::set<ExecutionState*>());
+      klee_message("worker %u: took %u states", (unsigned) WorkerId,
+                   (unsigned) newStates.size());
+      if (!newStates.empty())
+        return true;
+      createFile(request);
+      continue;
+    }
+
+    // Once every worker is idle or finished, no work is left. A claimed
+    // request means states are on their way, so the request is withdrawn
+    // the same way it is claimed.
+    if (fileExists(request)) {
+      bool allIdle = true;
+      for (unsigned id = 0; id < NumWorkers && allIdle; ++id)
+        if (id != WorkerId && !fileExists(getWorkerFile("request", id)) &&
+            !fileExists(getWorkerFile("done", id)))
+          allIdle = false;
+      std::string withdrawn = request + ".withdrawn";
+      if (allIdle && rename(request.c_str(), withdrawn.c_str()) == 0) {
+        unlink(withdrawn.c_str());
+        return false;
+      }
+    }
+
+    processTimers(0, MaxInstructionTime);
+    usleep(100000);
+  }
+
+  unlink(request.c_str());
+  return false;
+}
+
+static KTest *createKTest(const std::vector< std::pair<ref<const MemoryObject>, 
+                                                      const Array*> > &symbolics,
+                          const std::vector< std::vector<unsigned char> > &values) {
+  KTest *b = (KTest*) calloc(1, sizeof *b);
+  b->version = kTest_getCurrentVersion();
+  b->numObjects = symbolics.size();
+  b->objects = (KTestObject*) calloc(b->numObjects, sizeof *b->objects);
+  for (unsigned i = 0; i < b->numObjects; ++i) {
+    KTestObject *o = &b->objects[i];
+    o->name = strdup(symbolics[i].first->name.c_str());
+    o->numBytes = values[i].size();
+    o->bytes = (unsigned char*) malloc(o->numBytes);
+    std::copy(values[i].begin(), values[i].end(), o->bytes);
+  }
+  return b;
+}
+
+void Executor::runConcolic(ExecutionState &initialState) {
+  if (!usingSeeds || usingSeeds->empty())
+    klee_error("-concolic needs seed inputs (see -seed-out and -seed-out-dir)");
+
+  // Inputs to run, each with the number of leading constraints of its run
+  // whose branches must not be negated again (they were fixed by its
+  // parent).
+  std::deque< std::pair<KTest*, unsigned> > worklist;
+  for (std::vector<KTest*>::const_iterator it = usingSeeds->begin(), 
+         ie = usingSeeds->end(); it != ie; ++it)
+    worklist.push_back(std::make_pair(*it, 0U));
+
+  std::vector<KTest*> generated;
+  unsigned runs = 0;
+  while (!worklist.empty() && !haltExecution) {
+    KTest *input = worklist.front().first;
+    unsigned bound = worklist.front().second;
+    worklist.pop_front();
+
+    ExecutionState *es = new ExecutionState(initialState);
+    delete processTree;
+    processTree = new PTree(es);
+    es->ptreeNode = processTree->root;
+    if (pathWriter)
+      es->pathOS = pathWriter->open();
+    if (symPathWriter)
+      es->symPathOS = symPathWriter->open();
+    states.insert(es);
+    seedMap[es].push_back(SeedInfo(input));
+
+    concolicPath.clear();
+    concolicBranches.clear();
+    concolicSymbolics.clear();
+    concolicCoveredNew = false;
+    while (!states.empty() && !haltExecution) {
+      ExecutionState &state = **states.begin();
+      KInstruction *ki = state.pc;
+      stepInstruction(state);
+
+      executeInstruction(state, ki);
+      processTimers(&state, MaxInstructionTime);
+      updateStates(&state);
+    }
+    ++runs;
+    if (haltExecution)
+      break;
+
+    // Negate each new branch under the prefix leading to it.
+    std::vector<const Array*> objects;
+    for (unsigned i = 0; i != concolicSymbolics.size(); ++i)
+      objects.push_back(concolicSymbolics[i].second);
+    std::vector< std::pair<KTest*, unsigned> > children;
+    solver->setTimeout(stpTimeout);
+    for (unsigned b = 0; b < concolicBranches.size() && !haltExecution; ++b) {
+      unsigned i = concolicBranches[b];
+      if (i < bound)
+        continue;
+      std::vector< ref<Expr> > prefix(concolicPath.begin(), 
+                                      concolicPath.begin() + i);
+      ExecutionState tmp(prefix);
+      ref<Expr> negated = Expr::createIsZero(concolicPath[i]);
+      bool feasible;
+      if (!solver->mayBeTrue(tmp, negated, feasible) || !feasible)
+        continue;
+
+      tmp.addConstraint(negated);
+      std::vector< std::vector<unsigned char> > values;
+      if (!solver->getInitialValues(tmp, objects, values))
+        continue;
+      KTest *child = createKTest(concolicSymbolics, values);
+      generated.push_back(child);
+      children.push_back(std::make_pair(child, i + 1));
+    }
+    solver->setTimeout(0);
+
+    // Inputs of runs that covered new code are tried first.
+    if (concolicCoveredNew)
+      worklist.insert(worklist.begin(), children.begin(), children.end());
+    else
+      worklist.insert(worklist.end(), children.begin(), children.end());
+
+    if ((runs % 100) == 0)
+      klee_message("concolic: %u runs, %u inputs pending", runs, 
+                   (unsigned) worklist.size());
+  }
+
+  klee_message("concolic: %u runs, %u inputs generated", runs, 
+               (unsigned) generated.size());
+
+  for (std::set<ExecutionState*>::iterator it = states.begin(), 
+         ie = states.end(); it != ie; ++it) {
+    if (DumpStatesOnHalt)
+      terminateStateEarly(**it, "execution halting");
+    else
+      terminateState(**it);
   }
+  updateStates(0);
+
+  for (unsigned i = 0; i < generated.size(); ++i)
+    kTest_free(generated[i]);
+  delete &initialState;
 }
 
 void Executor::run(ExecutionState &initialState) {
@@ -2384,8 +3462,26 @@ void Executor::run(ExecutionState &initialState) {
   // optimization and such.
   initTimers();
 
+  if (Concolic) {
+    runConcolic(initialState);
+    return;
+  }
+
+  if (!WorkerDir.empty() && (NumWorkers < 2 || usingSeeds))
+    klee_error("-worker-dir requires -num-workers and cannot be used with seeds");
+
+  if (SpillStates || !ResumeFrom.empty() || !WorkerDir.empty()) {
+    if (RandomizeFork)
+      klee_error("-spill-states, -resume and -worker-dir cannot be used with -randomize-fork");
+    rootState = new ExecutionState(initialState);
+    rootState->ptreeNode = 0;
+  }
+
   states.insert(&initialState);
 
+  if (!ResumeFrom.empty())
+    resumeCheckpoint(initialState);
+
   if (usingSeeds) {
     std::vector<SeedInfo> &v = seedMap[&initialState];
     
@@ -2450,12 +3546,27 @@ void Executor::run(ExecutionState &initialState) {
       goto dump;
   }
 
+  if (NumWorkers > 1)
+    splitAmongWorkers();
+
   searcher = constructUserSearcher(*this);
 
   searcher->update(0, states, std::set<ExecutionState*>());
 
-  while (!states.empty() && !haltExecution) {
+  // With -worker-dir, a worker out of states asks the others for some of
+  // theirs, and busy workers check for such requests periodically. (Not
+  // initialized in its declaration, which the gotos above jump past.)
+  double nextWorkCheck;
+  nextWorkCheck = util::getWallTime() + WorkerPollInterval;
+  while (!haltExecution &&
+         (!states.empty() || (!WorkerDir.empty() && requestWork()))) {
     ExecutionState &state = searcher->selectState();
+    if (!state.resident) {
+      restoreState(state);
+      updateStates(0);
+      continue;
+    }
+
     KInstruction *ki = state.pc;
     stepInstruction(state);
 
@@ -2469,7 +3580,12 @@ void Executor::run(ExecutionState &initialState) {
         // to pummel the freelist once we hit the memory cap.
         unsigned mbs = sys::Process::GetTotalMemoryUsage() >> 20;
         
-        if (mbs > MaxMemory) {
+        if (SpillStates) {
+          // Forking stays enabled: restoring a state relies on every
+          // recorded branch having been forked.
+          if (mbs > MaxMemory)
+            evictStates(state, mbs);
+        } else if (mbs > MaxMemory) {
           if (mbs > MaxMemory + 100) {
             // just guess at how many to kill
             unsigned numStates = states.size();
@@ -2500,25 +3616,326 @@ void Executor::run(ExecutionState &initialState) {
     }
 
     updateStates(&state);
+
+    if (!WorkerDir.empty() && util::getWallTime() >= nextWorkCheck) {
+      serveWorkRequests();
+      nextWorkCheck = util::getWallTime() + WorkerPollInterval;
+    }
   }
 
+  if (!WorkerDir.empty())
+    createFile(getWorkerFile("done", WorkerId));
+
   delete searcher;
   searcher = 0;
   
  dump:
-  if (DumpStatesOnHalt && !states.empty()) {
+  // States in the checkpoint are continued by -resume, so dumping them as
+  // well would produce their tests twice.
+  bool checkpointed = false;
+  if (CheckpointInterval && !states.empty())
+    checkpointed = writeCheckpoint();
+
+  std::vector<ExecutionState*> remaining;
+  for (std::set<ExecutionState*>::iterator it = states.begin(), 
+         ie = states.end(); it != ie; ++it)
+    if (!checkpointed || !isCheckpointable(**it))
+      remaining.push_back(*it);
+
+  if (DumpStatesOnHalt && !remaining.empty()) {
     std::cerr << "KLEE: halting execution, dumping remaining states\n";
-    for (std::set<ExecutionState*>::iterator
-           it = states.begin(), ie = states.end();
-         it != ie; ++it) {
-      ExecutionState &state = **it;
-      stepInstruction(state); // keep stats rolling
-      terminateStateEarly(state, "execution halting");
+    // Evicted states have no inputs to write out, so they are rebuilt
+    // first, one at a time so that memory stays bounded.
+    for (std::vector<ExecutionState*>::iterator
+           it = remaining.begin(), ie = remaining.end(); it != ie; ++it) {
+      ExecutionState *state = *it;
+      if (!state->resident)
+        state = restoreState(*state);
+      if (state) {
+        stepInstruction(*state); // keep stats rolling
+        terminateStateEarly(*state, "execution halting", true);
+      }
+      updateStates(0);
     }
-    updateStates(0);
+  }
+
+  delete rootState;
+  rootState = 0;
+}
+
+bool Executor::isCheckpointable(const ExecutionState &state) const {
+  // A state that made an external call cannot be rebuilt by re-execution.
+  return !state.madeExternalCall;
+}
+
+bool Executor::writeCheckpoint() {
+  std::string path = interpreterHandler->getOutputFilename("checkpoint");
+  std::string tmpPath = path + ".tmp";
+  std::ofstream os(tmpPath.c_str());
+  if (!os.good()) {
+    klee_warning("unable to write checkpoint: %s", tmpPath.c_str());
+    return false;
+  }
+
+  if (statsTracker) {
+    std::vector<unsigned> covered;
+    for (unsigned id = 0, e = kmodule->infos->getMaxID(); id != e; ++id)
+      if (theStatisticManager->getIndexedValue(stats::coveredInstructions, id))
+        covered.push_back(id);
+    os << "covered " << covered.size();
+    for (unsigned i = 0; i < covered.size(); ++i)
+      os << " " << covered[i];
+    os << "\n";
+  }
+
+  // Each state is written as its stepped instruction count, its pc, its
+  // process tree path (prefixed by 'd') and its .path stream (prefixed by
+  // 'p'). The timers run before the states forked by the current
+  // instruction are moved out of addedStates, so those are written too.
+  std::set<ExecutionState*> live(states);
+  live.insert(addedStates.begin(), addedStates.end());
+  unsigned numStates = 0;
+  for (std::set<ExecutionState*>::iterator it = live.begin(), 
+         ie = live.end(); it != ie; ++it) {
+    ExecutionState *es = *it;
+    if (removedStates.count(es) || !isCheckpointable(*es))
+      continue;
+
+    writeStateRecord(os, *es);
+    ++numStates;
+  }
+
+  os.close();
+  if (!os.good() || rename(tmpPath.c_str(), path.c_str()) != 0) {
+    klee_warning("unable to write checkpoint: %s", path.c_str());
+    return false;
+  }
+  klee_message("checkpoint: %u states", numStates);
+  return true;
+}
+
+void Executor::writeStateRecord(std::ostream &os, ExecutionState &es) {
+  std::string decisions;
+  for (PTree::Node *n = es.ptreeNode; n->parent; n = n->parent)
+    decisions += n == n->parent->right ? '1' : '0';
+  std::reverse(decisions.begin(), decisions.end());
+
+  std::vector<unsigned char> branches;
+  if (pathWriter)
+    pathWriter->readStream(getPathStreamID(es), branches);
+
+  os << "state " << es.steppedInstructions << " " << es.pc->info->id
+     << " d" << decisions
+     << " p" << std::string(branches.begin(), branches.end()) << "\n";
+}
+
+void Executor::getInstructionsByID(std::map<unsigned, 
+                                            KInstruction**> &instructions) {
+  for (std::vector<KFunction*>::iterator it = kmodule->functions.begin(), 
+         ie = kmodule->functions.end(); it != ie; ++it) {
+    KFunction *kf = *it;
+    for (unsigned i = 0; i < kf->numInstructions; ++i)
+      instructions[kf->instructions[i]->info->id] = &kf->instructions[i];
   }
 }
 
+ExecutionState *
+Executor::readStateRecord(std::istream &is,
+                          std::map<unsigned, KInstruction**> &instructions) {
+  uint64_t stepped;
+  unsigned id;
+  std::string decisions, branches;
+  if (!(is >> stepped >> id >> decisions >> branches) ||
+      !instructions.count(id) || decisions[0] != 'd' || branches[0] != 'p')
+    return 0;
+
+  PTree::Node *n = processTree->root;
+  for (unsigned i = 1; i < decisions.size(); ++i) {
+    if (n->data)
+      return 0;
+    if (!n->left)
+      processTree->split(n, 0, 0);
+    n = decisions[i] == '1' ? n->right : n->left;
+  }
+  if (n->data || n->left)
+    return 0;
+
+  ExecutionState *es = new ExecutionState(*rootState);
+  es->evict();
+  es->steppedInstructions = stepped;
+  es->pc = es->prevPC = instructions[id];
+  // The path condition is not recorded, so it cannot be checked.
+  es->evictedConstraintsHash = 0;
+  es->ptreeNode = n;
+  n->data = es;
+  if (pathWriter) {
+    es->pathOS = pathWriter->open();
+    es->pathOS << branches.substr(1);
+  }
+  if (symPathWriter)
+    es->symPathOS = symPathWriter->open();
+  return es;
+}
+
+void Executor::pruneProcessTree() {
+  std::vector<PTree::Node*> stack, dead;
+  stack.push_back(processTree->root);
+  while (!stack.empty()) {
+    PTree::Node *n = stack.back();
+    stack.pop_back();
+    if (n->left) {
+      stack.push_back(n->left);
+      stack.push_back(n->right);
+    } else if (!n->data && n != processTree->root) {
+      dead.push_back(n);
+    }
+  }
+  for (unsigned i = 0; i < dead.size(); ++i)
+    processTree->remove(dead[i]);
+}
+
+void Executor::resumeCheckpoint(ExecutionState &initialState) {
+  if (usingSeeds || NumWorkers > 1)
+    klee_error("-resume cannot be used with seeds or -num-workers");
+
+  std::ifstream is(ResumeFrom.c_str());
+  if (!is.good())
+    klee_error("unable to open checkpoint: %s", ResumeFrom.c_str());
+
+  std::map<unsigned, KInstruction**> instructions;
+  getInstructionsByID(instructions);
+
+  // The recorded states replace the initial state in the process tree.
+  processTree->root->data = 0;
+  states.erase(&initialState);
+  delete &initialState;
+
+  std::string kind;
+  while (is >> kind) {
+    if (kind == "covered") {
+      unsigned n, id;
+      is >> n;
+      for (; n && is >> id; --n)
+        if (statsTracker)
+          statsTracker->markCovered(id);
+      continue;
+    }
+
+    ExecutionState *es = 0;
+    if (kind == "state")
+      es = readStateRecord(is, instructions);
+    if (!es)
+      klee_error("invalid checkpoint: %s", ResumeFrom.c_str());
+    states.insert(es);
+  }
+
+  // Drop the branches of the tree no recorded state is below.
+  pruneProcessTree();
+
+  klee_message("resuming %u states from %s", (unsigned) states.size(),
+               ResumeFrom.c_str());
+}
+
+void Executor::evictStates(ExecutionState &current, unsigned mbs) {
+  std::vector<ExecutionState*> arr;
+  for (std::set<ExecutionState*>::iterator it = states.begin(), 
+         ie = states.end(); it != ie; ++it) {
+    ExecutionState *es = *it;
+    // States added or removed in this step are still being processed.
+    if (es->resident && !es->madeExternalCall && es != &current &&
+        !addedStates.count(es) && !removedStates.count(es))
+      arr.push_back(es);
+  }
+
+  // just guess at how many to evict
+  unsigned numStates = arr.size() + 1;
+  unsigned toEvict = std::max(1U, numStates - numStates*MaxMemory/mbs);
+  klee_warning("evicting %d states (over memory cap)", 
+               std::min(toEvict, (unsigned) arr.size()));
+
+  for (unsigned i=0,N=arr.size(); N && i<toEvict; ++i,--N) {
+    unsigned idx = rand() % N;
+
+    // Make two pulls to try and not hit a state that covered new code.
+    if (arr[idx]->coveredNew)
+      idx = rand() % N;
+
+    std::swap(arr[idx], arr[N-1]);
+    arr[N-1]->evict();
+  }
+}
+
+ExecutionState *Executor::restoreState(ExecutionState &state) {
+  assert(!state.resident && rootState && "invalid state to restore");
+
+  // Right children of the process tree are the true sides of forks.
+  std::vector<bool> decisions;
+  for (PTree::Node *n = state.ptreeNode; n->parent; n = n->parent)
+    decisions.push_back(n == n->parent->right);
+  std::reverse(decisions.begin(), decisions.end());
+
+  ExecutionState *es = new ExecutionState(*rootState);
+  restoringState = es;
+  restoreDecisions.swap(decisions);
+  restorePosition = 0;
+  restoreDiverged = false;
+
+  while (!restoreDiverged && 
+         es->steppedInstructions < state.steppedInstructions) {
+    KInstruction *ki = es->pc;
+    ++es->steppedInstructions;
+    es->prevPC = es->pc;
+    ++es->pc;
+    executeInstruction(*es, ki);
+  }
+
+  bool success = !restoreDiverged && es->pc == state.pc &&
+    restorePosition == restoreDecisions.size();
+  restoringState = 0;
+  restoreDecisions.clear();
+
+  // Objects are not given the addresses they had when the path first ran,
+  // so a path that depends on addresses (a symbolic pointer, a pointer
+  // comparison) can follow the same branches and still end up with a
+  // different path condition. A zero hash, as for states recorded in a
+  // checkpoint, is not checked.
+  if (success && state.evictedConstraintsHash &&
+      es->computePathConditionHash() != state.evictedConstraintsHash) {
+    klee_warning_once(0, "rebuilt state has a different path condition "
+                      "(address dependent path?)");
+    success = false;
+  }
+
+  if (!success) {
+    klee_warning("unable to restore evicted state, terminating it");
+    delete es;
+    terminateState(state);
+    return 0;
+  }
+
+  es->ptreeNode = state.ptreeNode;
+  es->ptreeNode->data = es;
+  es->pathOS = state.pathOS;
+  es->symPathOS = state.symPathOS;
+  es->depth = state.depth;
+  es->weight = state.weight;
+  es->queryCost = state.queryCost;
+  es->instsSinceCovNew = state.instsSinceCovNew;
+  es->coveredNew = state.coveredNew;
+  es->coveredLines = state.coveredLines;
+
+  if (searcher) {
+    std::set<ExecutionState*> added, removed;
+    added.insert(es);
+    removed.insert(&state);
+    searcher->update(0, added, removed);
+  }
+  states.erase(&state);
+  states.insert(es);
+  delete &state;
+  return es;
+}
+
 std::string Executor::getAddressInfo(ExecutionState &state, 
                                      ref<Expr> address) const{
   std::ostringstream info;
@@ -2569,6 +3986,17 @@ std::string Executor::getAddressInfo(ExecutionState &state,
 }
 
 void Executor::terminateState(ExecutionState &state) {
+  if (Concolic && seedMap.count(&state)) {
+    concolicSymbolics = state.symbolics;
+    concolicCoveredNew = state.coveredNew;
+  }
+
+  if (&state == restoringState) {
+    // The path ended before reaching the evicted state.
+    restoreDiverged = true;
+    return;
+  }
+
   if (replayOut && replayPosition!=replayOut->numObjects) {
     klee_warning_once(replayOut, 
                       "replay did not consume all objects in test input.");
@@ -2593,18 +4021,32 @@ void Executor::terminateState(ExecutionState &state) {
   }
 }
 
+bool Executor::shouldOutputState(ExecutionState &state, bool isFrontier) {
+  // States terminated in the shared worker prefix are reported by worker 0.
+  if (inWorkerPrefix && WorkerId != 0)
+    return false;
+  if (&state == restoringState)
+    return false;
+  // The path of a halted state is where a later run (e.g. a klee-dist job
+  // with -replay-path-prefix) continues the exploration, so it must not be
+  // dropped for not covering anything new.
+  if (isFrontier && pathWriter)
+    return true;
+  return !OnlyOutputStatesCoveringNew || state.coveredNew ||
+    (AlwaysOutputSeeds && seedMap.count(&state));
+}
+
 void Executor::terminateStateEarly(ExecutionState &state, 
-                                   const Twine &message) {
-  if (!OnlyOutputStatesCoveringNew || state.coveredNew ||
-      (AlwaysOutputSeeds && seedMap.count(&state)))
+                                   const Twine &message,
+                                   bool isFrontier) {
+  if (shouldOutputState(state, isFrontier))
     interpreterHandler->processTestCase(state, (message + "\n").str().c_str(),
                                         "early");
   terminateState(state);
 }
 
 void Executor::terminateStateOnExit(ExecutionState &state) {
-  if (!OnlyOutputStatesCoveringNew || state.coveredNew || 
-      (AlwaysOutputSeeds && seedMap.count(&state)))
+  if (shouldOutputState(state))
     interpreterHandler->processTestCase(state, 0, 0);
   terminateState(state);
 }
@@ -2617,6 +4059,11 @@ void Executor::terminateStateOnError(ExecutionState &state,
   static std::set< std::pair<Instruction*, std::string> > emittedErrors;
   const InstructionInfo &ii = *state.prevPC->info;
   
+  if (&state == restoringState) {
+    terminateState(state);
+    return;
+  }
+
   if (EmitAllErrors ||
       emittedErrors.insert(std::make_pair(state.prevPC->inst, message)).second) {
     if (ii.file != "") {
@@ -2639,7 +4086,8 @@ void Executor::terminateStateOnError(ExecutionState &state,
     std::string info_str = info.str();
     if (info_str != "")
       msg << "Info: \n" << info_str;
-    interpreterHandler->processTestCase(state, msg.str().c_str(), suffix);
+    if (!inWorkerPrefix || WorkerId == 0)
+      interpreterHandler->processTestCase(state, msg.str().c_str(), suffix);
   }
     
   terminateState(state);
@@ -2669,6 +4117,15 @@ void Executor::callExternalFunction(ExecutionState &state,
     return;
   }
 
+  // The effects of an external call cannot be reproduced, so a path
+  // through one is not rebuilt, and states which made one are never
+  // evicted.
+  if (&state == restoringState) {
+    restoreDiverged = true;
+    return;
+  }
+  state.madeExternalCall = true;
+
   // normal external function handling path
   // allocate 128 bits for each argument (+return value) to support fp80's;
   // we could iterate through all the arguments first and determine the exact
@@ -2906,7 +4363,7 @@ void Executor::executeFree(ExecutionState &state,
     
     for (Executor::ExactResolutionList::iterator it = rl.begin(), 
            ie = rl.end(); it != ie; ++it) {
-      const MemoryObject *mo = it->first.first;
+      const MemoryObject *mo = it->first.first.get();
       if (mo->isLocal) {
         terminateStateOnError(*it->second, 
                               "free of alloca", 
@@ -2963,7 +4420,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                       ref<Expr> value /* undef if read */,
                                       KInstruction *target /* undef if write */) {
   Expr::Width type = (isWrite ? value->getWidth() : 
-                     getWidthForLLVMType(target->inst->getType()));
+                     target->width);
   unsigned bytes = Expr::getMinBytesForWidth(type);
 
   if (!state.watchpoint.isNull() && isWrite) {
@@ -2998,7 +4455,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
   solver->setTimeout(0);
 
   if (success) {
-    const MemoryObject *mo = op.first;
+    const MemoryObject *mo = op.first.get();
 
     if (MaxSymArraySize && mo->size>=MaxSymArraySize) {
       address = toConstant(state, address, "max-sym-array-size");
@@ -3055,7 +4512,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
   ExecutionState *unbound = &state;
   
   for (ResolutionList::iterator i = rl.begin(), ie = rl.end(); i != ie; ++i) {
-    const MemoryObject *mo = i->first;
+    const MemoryObject *mo = i->first.get();
     const ObjectState *os = i->second;
     ref<Expr> inBounds = mo->getBoundsCheckPointer(address, bytes);
     
@@ -3314,7 +4771,7 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
   ExecutionState tmp(state);
   if (!NoPreferCex) {
     for (unsigned i = 0; i != state.symbolics.size(); ++i) {
-      const MemoryObject *mo = state.symbolics[i].first;
+      const MemoryObject *mo = state.symbolics[i].first.get();
       std::vector< ref<Expr> >::const_iterator pi = 
         mo->cexPreferences.begin(), pie = mo->cexPreferences.end();
       for (; pi != pie; ++pi) {
@@ -128,8 +128,9 @@ private:
   /// on as-yet-to-be-determined flags.
   std::map<ExecutionState*, std::vector<SeedInfo> > seedMap;
   
-  /// Map of globals to their representative memory object.
-  std::map<const llvm::GlobalValue*, MemoryObject*> globalObjects;
+  /// Map of globals to their representative memory object, which it keeps
+  /// alive for the whole run.
+  std::map<const llvm::GlobalValue*, ref<MemoryObject> > globalObjects;
 
   /// Map of globals to their bound address. This also includes
   /// globals that have no representative object (i.e. functions).
@@ -159,6 +160,36 @@ private:
   /// Disables forking, set by client. \see setInhibitForking()
   bool inhibitForking;
 
+  /// Set while running the exploration prefix shared by all -num-workers
+  /// processes. \see splitAmongWorkers()
+  bool inWorkerPrefix;
+
+  /// With -spill-states, a copy of the initial state from which evicted
+  /// states are rebuilt. \see restoreState()
+  ExecutionState *rootState;
+
+  /// The state being rebuilt by restoreState(), which follows the branch
+  /// decisions in \ref restoreDecisions instead of forking.
+  ExecutionState *restoringState;
+  std::vector<bool> restoreDecisions;
+  unsigned restorePosition;
+  /// Set when the rebuilt state does not follow its recorded path.
+  bool restoreDiverged;
+
+  /// With -concolic, every constraint added along the current run (in
+  /// order), the positions in it of the branch conditions, which are the
+  /// ones negated to generate new inputs, and the symbolic objects and
+  /// coverage of its state when it terminated.
+  std::vector< ref<Expr> > concolicPath;
+  std::vector<unsigned> concolicBranches;
+  std::vector< std::pair<ref<const MemoryObject>, const Array*> > 
+    concolicSymbolics;
+  bool concolicCoveredNew;
+
+  /// With -prune-redundant-states, the hashes of all states seen entering a
+  /// loop. \see transferToBasicBlock()
+  std::set<uint64_t> stateHashes;
+
   /// Signals the executor to halt execution at the next instruction
   /// step.
   bool haltExecution;  
@@ -173,11 +204,64 @@ private:
   llvm::Function* getCalledFunction(llvm::CallSite &cs, ExecutionState &state);
   
   void executeInstruction(ExecutionState &state, KInstruction *ki);
+  /// Execute an instruction with a concrete handler through that handler
+  /// when its operands are concrete, without building expressions. Returns
+  /// false if the instruction must take the general path.
+  bool executeConcreteInstruction(ExecutionState &state, KInstruction *ki);
 
   void printFileLine(ExecutionState &state, KInstruction *ki);
 
   void run(ExecutionState &initialState);
 
+  /// Evict resident states other than \a current to bring memory usage
+  /// (\a mbs megabytes) back under -max-memory.
+  void evictStates(ExecutionState &current, unsigned mbs);
+
+  /// Rebuild the evicted \a state by re-executing its path from \ref
+  /// rootState, replacing it in the searcher and process tree, and return
+  /// the rebuilt state. States whose path cannot be reproduced are
+  /// terminated and 0 is returned.
+  ExecutionState *restoreState(ExecutionState &state);
+
+  /// Replace \a initialState by the evicted states recorded in the
+  /// -resume checkpoint, which are rebuilt when first selected.
+  void resumeCheckpoint(ExecutionState &initialState);
+
+  /// Write the record of \a es read back by readStateRecord(): its stepped
+  /// instruction count, pc, process tree path and .path stream.
+  void writeStateRecord(std::ostream &os, ExecutionState &es);
+
+  /// Read the rest of a "state" record and add an evicted copy of \ref
+  /// rootState for it to the process tree. Returns 0 if the record is
+  /// malformed or its path conflicts with an existing state.
+  ExecutionState *readStateRecord(std::istream &is,
+                                  std::map<unsigned, 
+                                           KInstruction**> &instructions);
+
+  /// Map each instruction id to its slot in its KFunction, for
+  /// readStateRecord().
+  void getInstructionsByID(std::map<unsigned, KInstruction**> &instructions);
+
+  /// Remove the leaves of the process tree that hold no state.
+  void pruneProcessTree();
+
+  /// Generational search: run each input along a single path, then make
+  /// new inputs by negating in turn the branches the run took past the
+  /// point where its own input was generated.
+  void runConcolic(ExecutionState &initialState);
+
+  /// Explore deterministically until there are enough states to share
+  /// among the -num-workers processes, then keep only this worker's share.
+  void splitAmongWorkers();
+
+  /// Claim the pending requests of idle workers in -worker-dir and hand
+  /// each half of this worker's movable states.
+  void serveWorkRequests();
+
+  /// Wait in -worker-dir for another worker to hand over states. Returns
+  /// false once every worker is idle or done, or on halt.
+  bool requestWork();
+
   // Given a concrete object in our [klee's] address space, add it to 
   // objects checked code can reference.
   MemoryObject *addExternalObject(ExecutionState &state, void *addr, 
@@ -210,8 +294,8 @@ private:
   /// \param results[out] A list of ((MemoryObject,ObjectState),
   /// state) pairs for each object the given address can point to the
   /// beginning of.
-  typedef std::vector< std::pair<std::pair<const MemoryObject*, const ObjectState*>, 
-                                 ExecutionState*> > ExactResolutionList;
+  typedef std::vector< std::pair<ObjectPair, ExecutionState*> > 
+    ExactResolutionList;
   void resolveExact(ExecutionState &state,
                     ref<Expr> p,
                     ExactResolutionList &results,
@@ -292,12 +376,12 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.back().getLocalForWrite(kf->getArgRegister(index));
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().getLocalForWrite(target->dest);
   }
 
   void bindLocal(KInstruction *target, 
@@ -333,8 +417,12 @@ private:
 
   // remove state from queue and delete
   void terminateState(ExecutionState &state);
+  // whether a terminated state gets a test case; frontier states (those
+  // left when execution halts) always do when paths are written
+  bool shouldOutputState(ExecutionState &state, bool isFrontier = false);
   // call exit handler and terminate state
-  void terminateStateEarly(ExecutionState &state, const llvm::Twine &message);
+  void terminateStateEarly(ExecutionState &state, const llvm::Twine &message,
+                           bool isFrontier = false);
   // call exit handler and terminate state
   void terminateStateOnExit(ExecutionState &state);
   // call error handler and terminate state
@@ -422,6 +510,14 @@ public:
                                  char **argv,
                                  char **envp);
 
+  /// Record the live states (as process tree paths) and the coverage so
+  /// far in the "checkpoint" output file, from which the run can be
+  /// continued with -resume. Returns false if the file cannot be written.
+  bool writeCheckpoint();
+
+  /// Whether \a state can be recorded in a checkpoint and rebuilt from it.
+  bool isCheckpointable(const ExecutionState &state) const;
+
   /*** Runtime options ***/
   
   virtual void setHaltExecution(bool value) {
@@ -37,6 +37,11 @@ MaxTime("max-time",
         cl::desc("Halt execution after the specified number of seconds (0=off)"),
         cl::init(0));
 
+cl::opt<double>
+CheckpointInterval("checkpoint-interval",
+                   cl::desc("Write a checkpoint for -resume to the output directory every this many seconds (0=off)"),
+                   cl::init(0));
+
 ///
 
 class HaltTimer : public Executor::Timer {
@@ -54,6 +59,20 @@ public:
 
 ///
 
+class CheckpointTimer : public Executor::Timer {
+  Executor *executor;
+
+public:
+  CheckpointTimer(Executor *_executor) : executor(_executor) {}
+  ~CheckpointTimer() {}
+
+  void run() {
+    executor->writeCheckpoint();
+  }
+};
+
+///
+
 static const double kSecondsPerTick = .1;
 static volatile unsigned timerTicks = 0;
 
@@ -90,6 +109,10 @@ void Executor::initTimers() {
   if (MaxTime) {
     addTimer(new HaltTimer(this), MaxTime);
   }
+
+  if (CheckpointInterval) {
+    addTimer(new CheckpointTimer(this), CheckpointInterval);
+  }
 }
 
 ///
@@ -16,6 +16,7 @@
 #include "klee/Solver.h"
 #include "klee/util/BitArray.h"
 
+#include "MemoryManager.h"
 #include "ObjectHolder.h"
 
 #include <llvm/Function.h>
@@ -26,6 +27,7 @@
 
 #include <iostream>
 #include <cassert>
+#include <map>
 #include <sstream>
 
 using namespace llvm;
@@ -35,6 +37,18 @@ namespace {
   cl::opt<bool>
   UseConstantArrays("use-constant-arrays",
                     cl::init(true));
+
+  cl::opt<unsigned>
+  UpdateCompactionThreshold("update-compaction-threshold",
+                            cl::desc("Fold chains of at least this many concrete "
+                                     "updates into a new constant array (0=off)"),
+                            cl::init(64));
+
+  cl::opt<unsigned>
+  ConstantArrayCacheSize("constant-array-cache-size",
+                         cl::desc("Number of constant array snapshots remembered "
+                                  "for sharing by content (0=off, default=1024)"),
+                         cl::init(1024));
 }
 
 /***/
@@ -63,6 +77,8 @@ ObjectHolder &ObjectHolder::operator=(const ObjectHolder &b) {
 int MemoryObject::counter = 0;
 
 MemoryObject::~MemoryObject() {
+  if (parent)
+    parent->deallocate(this);
 }
 
 void MemoryObject::getAllocInfo(std::string &result) const {
@@ -97,7 +113,12 @@ ObjectState::ObjectState(const MemoryObject *mo)
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
+    knownSpans(0),
+    spanMask(0),
     updates(0, 0),
+    contentHash(0),
+    boundHash(0),
+    hasBoundHash(false),
     size(mo->size),
     readOnly(false) {
   if (!UseConstantArrays) {
@@ -106,6 +127,7 @@ ObjectState::ObjectState(const MemoryObject *mo)
     const Array *array = new Array("tmp_arr" + llvm::utostr(++id), size);
     updates = UpdateList(array, 0);
   }
+  rehash();
 }
 
 
@@ -117,7 +139,12 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
+    knownSpans(0),
+    spanMask(0),
     updates(array, 0),
+    contentHash(0),
+    boundHash(0),
+    hasBoundHash(false),
     size(mo->size),
     readOnly(false) {
   makeSymbolic();
@@ -131,7 +158,12 @@ ObjectState::ObjectState(const ObjectState &os)
     concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : 0),
     flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
     knownSymbolics(0),
+    knownSpans(0),
+    spanMask(os.spanMask ? new BitArray(*os.spanMask, os.size) : 0),
     updates(os.updates),
+    contentHash(os.contentHash),
+    boundHash(0),
+    hasBoundHash(false),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
@@ -142,6 +174,12 @@ ObjectState::ObjectState(const ObjectState &os)
       knownSymbolics[i] = os.knownSymbolics[i];
   }
 
+  if (os.knownSpans) {
+    knownSpans = new ref<Expr>[size];
+    for (unsigned i=0; i<size; i++)
+      knownSpans[i] = os.knownSpans[i];
+  }
+
   memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
 }
 
@@ -149,20 +187,75 @@ ObjectState::~ObjectState() {
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
   if (knownSymbolics) delete[] knownSymbolics;
+  if (knownSpans) delete[] knownSpans;
+  if (spanMask) delete spanMask;
   delete[] concreteStore;
 }
 
 /***/
 
+/// Return a constant array with the given contents, reusing a previously
+/// created array with identical contents if there is one. Sharing roots
+/// keeps update list comparisons cheap and lets the solver reuse the array
+/// encoding across objects and states.
+static const Array *getConstantArray(const std::vector< ref<ConstantExpr> > &Contents) {
+  // Arrays are found by a hash of their contents, so the cache holds no copy
+  // of them. It is flushed when it reaches its size limit; later snapshots
+  // are then simply not shared with the forgotten ones.
+  static std::multimap<unsigned, const Array*> constantArrays;
+  typedef std::multimap<unsigned, const Array*>::iterator iterator;
+
+  unsigned hash = Contents.size();
+  for (unsigned i = 0, e = Contents.size(); i != e; ++i)
+    hash = hash * 31 + Contents[i]->getZExtValue(8);
+
+  if (ConstantArrayCacheSize) {
+    std::pair<iterator, iterator> range = constantArrays.equal_range(hash);
+    for (iterator it = range.first; it != range.second; ++it) {
+      const Array *array = it->second;
+      if (array->size != Contents.size())
+        continue;
+      unsigned i = 0, e = Contents.size();
+      for (; i != e; ++i)
+        if (array->constantValues[i]->getZExtValue(8) != 
+            Contents[i]->getZExtValue(8))
+          break;
+      if (i == e)
+        return array;
+    }
+  }
+
+  // FIXME: Leaked.
+  static unsigned id = 0;
+  const Array *array = new Array("const_arr" + llvm::utostr(++id), 
+                                 Contents.size(),
+                                 &Contents[0], &Contents[0] + Contents.size());
+  if (ConstantArrayCacheSize) {
+    if (constantArrays.size() >= ConstantArrayCacheSize)
+      constantArrays.clear();
+    constantArrays.insert(std::make_pair(hash, array));
+  }
+  return array;
+}
+
 const UpdateList &ObjectState::getUpdates() const {
-  // Constant arrays are created lazily.
-  if (!updates.root) {
+  // Constant arrays are created lazily. Long chains of concrete updates on
+  // top of a constant array (as left behind by repeated flushes for symbolic
+  // reads) are folded back into a new constant array, so that later reads
+  // and solver queries do not pay for the whole write history.
+  unsigned NumWrites = updates.head ? updates.head->getSize() : 0;
+  bool compact = (updates.root && updates.root->isConstantArray() &&
+                  UpdateCompactionThreshold &&
+                  NumWrites >= UpdateCompactionThreshold &&
+                  NumWrites * 8 >= size &&
+                  updates.head->isConcrete());
+
+  if (!updates.root || compact) {
     // Collect the list of writes, with the oldest writes first.
     
     // FIXME: We should be able to do this more efficiently, we just need to be
     // careful to get the interaction with the cache right. In particular we
     // should avoid creating UpdateNode instances we never use.
-    unsigned NumWrites = updates.head ? updates.head->getSize() : 0;
     std::vector< std::pair< ref<Expr>, ref<Expr> > > Writes(NumWrites);
     const UpdateNode *un = updates.head;
     for (unsigned i = NumWrites; i != 0; un = un->next) {
@@ -172,9 +265,13 @@ const UpdateList &ObjectState::getUpdates() const {
 
     std::vector< ref<ConstantExpr> > Contents(size);
 
-    // Initialize to zeros.
-    for (unsigned i = 0, e = size; i != e; ++i)
-      Contents[i] = ConstantExpr::create(0, Expr::Int8);
+    // Initialize to the existing constant array, or to zeros.
+    if (updates.root) {
+      Contents = updates.root->constantValues;
+    } else {
+      for (unsigned i = 0, e = size; i != e; ++i)
+        Contents[i] = ConstantExpr::create(0, Expr::Int8);
+    }
 
     // Pull off as many concrete writes as we can.
     unsigned Begin = 0, End = Writes.size();
@@ -191,16 +288,8 @@ const UpdateList &ObjectState::getUpdates() const {
       Contents[Index->getZExtValue()] = Value;
     }
 
-    // FIXME: We should unique these, there is no good reason to create multiple
-    // ones.
-
     // Start a new update list.
-    // FIXME: Leaked.
-    static unsigned id = 0;
-    const Array *array = new Array("const_arr" + llvm::utostr(++id), size,
-                                   &Contents[0],
-                                   &Contents[0] + Contents.size());
-    updates = UpdateList(array, 0);
+    updates = UpdateList(getConstantArray(Contents), 0);
 
     // Apply the remaining (non-constant) writes.
     for (; Begin != End; ++Begin)
@@ -217,6 +306,7 @@ void ObjectState::makeConcrete() {
   concreteMask = 0;
   flushMask = 0;
   knownSymbolics = 0;
+  clearSpans();
 }
 
 void ObjectState::makeSymbolic() {
@@ -229,11 +319,13 @@ void ObjectState::makeSymbolic() {
     setKnownSymbolic(i, 0);
     markByteFlushed(i);
   }
+  rehash();
 }
 
 void ObjectState::initializeToZero() {
   makeConcrete();
   memset(concreteStore, 0, size);
+  rehash();
 }
 
 void ObjectState::initializeToRandom() {  
@@ -242,6 +334,41 @@ void ObjectState::initializeToRandom() {
     // randomly selected by 256 sided die
     concreteStore[i] = 0xAB;
   }
+  rehash();
+}
+
+/// Mix a byte offset and value into a well distributed 64-bit hash. The
+/// object hash is the sum of these over all bytes, so that a single byte
+/// can be updated without rehashing the rest.
+static uint64_t mixByte(unsigned offset, uint64_t value) {
+  uint64_t h = (offset + 1) * 0x9E3779B97F4A7C15ULL ^ value * 0xC2B2AE3D27D4EB4FULL;
+  h ^= h >> 29;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t ObjectState::byteHash(unsigned offset) const {
+  // The contents of flushed bytes live in the update list, which is hashed
+  // separately.
+  if (isByteFlushed(offset))
+    return mixByte(offset, 0x100);
+  if (isByteConcrete(offset))
+    return mixByte(offset, concreteStore[offset]);
+  return mixByte(offset, 0x200 + (uint64_t) knownSymbolics[offset]->hash());
+}
+
+void ObjectState::rehash() {
+  contentHash = 0;
+  for (unsigned i=0; i<size; i++)
+    contentHash += byteHash(i);
+}
+
+uint64_t ObjectState::hash() const {
+  uint64_t h = contentHash ^ ((uint64_t) size << 32);
+  if (updates.head)
+    h += mixByte(updates.head->getSize(), updates.head->hash());
+  return h ^ (uint64_t) (uintptr_t) updates.root;
 }
 
 /*
@@ -265,6 +392,7 @@ void ObjectState::flushRangeForRead(unsigned rangeBase,
  
   for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
     if (!isByteFlushed(offset)) {
+      contentHash -= byteHash(offset);
       if (isByteConcrete(offset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
                        ConstantExpr::create(concreteStore[offset], Expr::Int8));
@@ -275,6 +403,7 @@ void ObjectState::flushRangeForRead(unsigned rangeBase,
       }
 
       flushMask->unset(offset);
+      contentHash += byteHash(offset);
     }
   } 
 }
@@ -284,7 +413,9 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
   if (!flushMask) flushMask = new BitArray(size, true);
 
   for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
+    killSpan(offset);
     if (!isByteFlushed(offset)) {
+      contentHash -= byteHash(offset);
       if (isByteConcrete(offset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
                        ConstantExpr::create(concreteStore[offset], Expr::Int8));
@@ -297,6 +428,7 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
       }
 
       flushMask->unset(offset);
+      contentHash += byteHash(offset);
     } else {
       // flushed bytes that are written over still need
       // to be marked out
@@ -357,6 +489,42 @@ void ObjectState::setKnownSymbolic(unsigned offset,
   }
 }
 
+void ObjectState::setKnownSpan(unsigned offset, ref<Expr> value) {
+  if (!knownSpans) {
+    knownSpans = new ref<Expr>[size];
+    spanMask = new BitArray(size, false);
+  }
+  knownSpans[offset] = value;
+  for (unsigned i=0, e=value->getWidth()/8; i<e; i++)
+    spanMask->set(offset + i);
+}
+
+void ObjectState::killSpan(unsigned offset) {
+  if (!spanMask || !spanMask->get(offset))
+    return;
+
+  unsigned start = getSpanStart(offset);
+  for (unsigned i=0, e=knownSpans[start]->getWidth()/8; i<e; i++)
+    spanMask->unset(start + i);
+  knownSpans[start] = 0;
+}
+
+void ObjectState::clearSpans() {
+  if (knownSpans) delete[] knownSpans;
+  if (spanMask) delete spanMask;
+  knownSpans = 0;
+  spanMask = 0;
+}
+
+// Spans never overlap, so the span covering a byte is the nearest one
+// starting at or before it.
+unsigned ObjectState::getSpanStart(unsigned offset) const {
+  assert(spanMask && spanMask->get(offset) && "byte is not in a span");
+  while (!knownSpans[offset].get())
+    --offset;
+  return offset;
+}
+
 /***/
 
 ref<Expr> ObjectState::read8(unsigned offset) const {
@@ -391,11 +559,14 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
 
 void ObjectState::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
+  killSpan(offset);
+  contentHash -= byteHash(offset);
   concreteStore[offset] = value;
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
   markByteUnflushed(offset);
+  contentHash += byteHash(offset);
 }
 
 void ObjectState::write8(unsigned offset, ref<Expr> value) {
@@ -403,10 +574,13 @@ void ObjectState::write8(unsigned offset, ref<Expr> value) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     write8(offset, (uint8_t) CE->getZExtValue(8));
   } else {
+    killSpan(offset);
+    contentHash -= byteHash(offset);
     setKnownSymbolic(offset, value.get());
       
     markByteSymbolic(offset);
     markByteUnflushed(offset);
+    contentHash += byteHash(offset);
   }
 }
 
@@ -461,6 +635,18 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
+  // Reads within the bytes of a single earlier store get the stored value
+  // back, or the part of it they cover, without going through the bytes.
+  if (width > Expr::Int8 && spanMask && spanMask->get(offset)) {
+    unsigned start = getSpanStart(offset);
+    const ref<Expr> &span = knownSpans[start];
+    if (offset == start && span->getWidth() == width)
+      return span;
+    if (Context::get().isLittleEndian() &&
+        (offset - start) * 8 + width <= span->getWidth())
+      return ExtractExpr::create(span, (offset - start) * 8, width);
+  }
+
   // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid write size!");
@@ -532,6 +718,11 @@ void ObjectState::write(unsigned offset, ref<Expr> value) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
     write8(offset + idx, ExtractExpr::create(value, 8 * i, Expr::Int8));
   }
+
+  // The bytes stay the authoritative contents, the span only remembers
+  // the value they were cut from.
+  if (NumBytes > 1)
+    setKnownSpan(offset, value);
 } 
 
 void ObjectState::write16(unsigned offset, uint16_t value) {
@@ -30,10 +30,20 @@ class Solver;
 
 class MemoryObject {
   friend class STPBuilder;
+  friend class MemoryManager;
+  friend class ref<MemoryObject>;
+  friend class ref<const MemoryObject>;
 
 private:
   static int counter;
 
+  /// Number of ObjectStates, stack frames and symbolic bindings referring
+  /// to this object; it is released to its parent once this drops to zero.
+  mutable unsigned refCount;
+
+  /// The MemoryManager this object was allocated by, if any.
+  MemoryManager *parent;
+
 public:
   unsigned id;
   uint64_t address;
@@ -69,7 +79,9 @@ public:
   // XXX this is just a temp hack, should be removed
   explicit
   MemoryObject(uint64_t _address) 
-    : id(counter++),
+    : refCount(0),
+      parent(0),
+      id(counter++),
       address(_address),
       size(0),
       isFixed(true),
@@ -78,8 +90,11 @@ public:
 
   MemoryObject(uint64_t _address, unsigned _size, 
                bool _isLocal, bool _isGlobal, bool _isFixed,
-               const llvm::Value *_allocSite) 
-    : id(counter++),
+               const llvm::Value *_allocSite,
+               MemoryManager *_parent) 
+    : refCount(0),
+      parent(_parent),
+      id(counter++),
       address(_address),
       size(_size),
       name("unnamed"),
@@ -143,7 +158,7 @@ private:
   friend class ObjectHolder;
   unsigned refCount;
 
-  const MemoryObject *object;
+  ref<const MemoryObject> object;
 
   uint8_t *concreteStore;
   // XXX cleanup name of flushMask (its backwards or something)
@@ -154,9 +169,27 @@ private:
 
   ref<Expr> *knownSymbolics;
 
+  /// Values of multi-byte symbolic stores, at the offset of their first
+  /// byte, for as long as none of the bytes they cover is overwritten.
+  /// Lets a reload return the stored value instead of reassembling it.
+  ref<Expr> *knownSpans;
+
+  /// Bytes covered by an entry of knownSpans.
+  BitArray *spanMask;
+
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// Sum of byteHash() over all bytes, kept up to date by every write and
+  /// flush so that hashing an object does not need to walk its contents.
+  mutable uint64_t contentHash;
+
+  /// hash() as taken by AddressSpace::hash(), kept so that the address
+  /// space later subtracts exactly what it added even if a read has since
+  /// flushed bytes. Dropped by AddressSpace::getWriteable().
+  mutable uint64_t boundHash;
+  mutable bool hasBoundHash;
+
 public:
   unsigned size;
 
@@ -175,7 +208,7 @@ public:
   ObjectState(const ObjectState &os);
   ~ObjectState();
 
-  const MemoryObject *getObject() const { return object; }
+  const MemoryObject *getObject() const { return object.get(); }
 
   void setReadOnly(bool ro) { readOnly = ro; }
 
@@ -197,6 +230,11 @@ public:
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
 
+  /// Return a hash of the object contents. Objects with equal contents
+  /// usually have equal hashes, but the same contents may hash differently
+  /// depending on how much of it has been flushed to the update list.
+  uint64_t hash() const;
+
 private:
   const UpdateList &getUpdates() const;
 
@@ -223,6 +261,14 @@ private:
   void markByteUnflushed(unsigned offset);
   void setKnownSymbolic(unsigned offset, Expr *value);
 
+  void setKnownSpan(unsigned offset, ref<Expr> value);
+  void killSpan(unsigned offset);
+  void clearSpans();
+  unsigned getSpanStart(unsigned offset) const;
+
+  uint64_t byteHash(unsigned offset) const;
+  void rehash();
+
   void print();
 };
   
@@ -19,16 +19,110 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include <sys/mman.h>
+
+using namespace llvm;
 using namespace klee;
 
+namespace {
+  cl::opt<unsigned>
+  MemoryArenaSize("memory-arena-size",
+                  cl::desc("Size of the address range reserved for memory "
+                           "objects, in MB (0=use malloc)"),
+                  cl::init(sizeof(void*) == 8 ? 4096 : 256));
+
+  cl::opt<unsigned>
+  MemoryQuarantineSize("memory-quarantine-size",
+                       cl::desc("Amount of released memory, in MB, to hold "
+                                "back before its addresses are reused "
+                                "(default=64)"),
+                       cl::init(64));
+
+  cl::opt<bool>
+  DeterministicAllocation("allocate-deterministic",
+                          cl::desc("Allocate memory objects at the same "
+                                   "addresses across runs"),
+                          cl::init(false));
+}
+
+/// The address the arena is placed at with -allocate-deterministic.
+static const uint64_t DeterministicArenaAddress = 0x7ff30000000ULL;
+
+/// The smallest block handed out; also the alignment of every block.
+static const unsigned MinBlockBits = 4;
+
+/// Return the size class for an allocation of \a size bytes.
+static unsigned getSizeClass(uint64_t size) {
+  unsigned sizeClass = 0;
+  while ((1ULL << (MinBlockBits + sizeClass)) < size)
+    ++sizeClass;
+  return sizeClass;
+}
+
 /***/
 
+MemoryManager::MemoryManager() 
+  : arena(0), arenaSize(0), arenaUsed(0), quarantineSize(0) {
+  if (!MemoryArenaSize) {
+    if (DeterministicAllocation)
+      klee_error("-allocate-deterministic requires a memory arena");
+    return;
+  }
+
+  arenaSize = (uint64_t) MemoryArenaSize << 20;
+  void *hint = 0;
+  if (DeterministicAllocation)
+    hint = (void*) (unsigned long) DeterministicArenaAddress;
+
+  void *res = mmap(hint, arenaSize, PROT_READ | PROT_WRITE, 
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (res == MAP_FAILED) {
+    if (DeterministicAllocation)
+      klee_error("unable to reserve memory arena (%u MB)", 
+                 (unsigned) MemoryArenaSize);
+    klee_warning("unable to reserve memory arena (%u MB), using malloc",
+                 (unsigned) MemoryArenaSize);
+    arenaSize = 0;
+    return;
+  }
+
+  if (DeterministicAllocation && res != hint)
+    klee_error("unable to reserve memory arena at %#llx",
+               (unsigned long long) DeterministicArenaAddress);
+
+  arena = (char*) res;
+}
+
 MemoryManager::~MemoryManager() { 
-  while (!objects.empty()) {
-    MemoryObject *mo = objects.back();
-    objects.pop_back();
-    delete mo;
+  // Objects still alive at this point (if any) must not call back into
+  // us.
+  for (objects_ty::iterator it = objects.begin(), ie = objects.end();
+       it != ie; ++it)
+    it->second->parent = 0;
+
+  if (arena)
+    munmap(arena, arenaSize);
+}
+
+uint64_t MemoryManager::allocateFromArena(uint64_t size) {
+  unsigned sizeClass = getSizeClass(size);
+  if (sizeClass >= freeLists.size())
+    freeLists.resize(sizeClass + 1);
+
+  std::vector<uint64_t> &freeList = freeLists[sizeClass];
+  if (!freeList.empty()) {
+    uint64_t address = freeList.back();
+    freeList.pop_back();
+    return address;
   }
+
+  uint64_t blockSize = 1ULL << (MinBlockBits + sizeClass);
+  if (arenaUsed + blockSize > arenaSize)
+    return 0;
+
+  uint64_t address = (uint64_t) (unsigned long) (arena + arenaUsed);
+  arenaUsed += blockSize;
+  return address;
 }
 
 MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal, 
@@ -38,23 +132,45 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
     klee_warning_once(0, "failing large alloc: %u bytes", (unsigned) size);
     return 0;
   }
-  uint64_t address = (uint64_t) (unsigned long) malloc((unsigned) size);
-  if (!address)
-    return 0;
+
+  uint64_t address = 0;
+  if (arena)
+    address = allocateFromArena(size);
+  if (!address) {
+    // Addresses outside of the arena would break reproducibility.
+    if (DeterministicAllocation) {
+      klee_warning_once(0, "memory arena exhausted, failing alloc");
+      return 0;
+    }
+    if (arena)
+      klee_warning_once(0, "memory arena exhausted, using malloc");
+
+    // Blocks obtained from malloc are never released, so their addresses
+    // are never reused.
+    address = (uint64_t) (unsigned long) malloc((unsigned) size);
+    if (!address)
+      return 0;
+  }
   
   ++stats::allocations;
   MemoryObject *res = new MemoryObject(address, size, isLocal, isGlobal, false,
-                                       allocSite);
-  objects.push_back(res);
+                                       allocSite, this);
+  objects.insert(std::make_pair(address, res));
   return res;
 }
 
 MemoryObject *MemoryManager::allocateFixed(uint64_t address, uint64_t size,
                                            const llvm::Value *allocSite) {
 #ifndef NDEBUG
-  for (objects_ty::iterator it = objects.begin(), ie = objects.end();
-       it != ie; ++it) {
-    MemoryObject *mo = *it;
+  // Only the closest live objects on either side can overlap.
+  objects_ty::iterator next = objects.lower_bound(address);
+  if (next != objects.end()) {
+    MemoryObject *mo = next->second;
+    assert(!(address+size > mo->address && address < mo->address+mo->size) &&
+           "allocated an overlapping object");
+  }
+  if (next != objects.begin()) {
+    MemoryObject *mo = (--next)->second;
     assert(!(address+size > mo->address && address < mo->address+mo->size) &&
            "allocated an overlapping object");
   }
@@ -62,11 +178,29 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t address, uint64_t size,
 
   ++stats::allocations;
   MemoryObject *res = new MemoryObject(address, size, false, true, true,
-                                       allocSite);
-  objects.push_back(res);
+                                       allocSite, this);
+  objects.insert(std::make_pair(address, res));
   return res;
 }
 
 void MemoryManager::deallocate(const MemoryObject *mo) {
-  assert(0);
+  objects_ty::iterator it = objects.find(mo->address);
+  if (it != objects.end() && it->second == mo)
+    objects.erase(it);
+
+  if (mo->isFixed || !isArenaAddress(mo->address))
+    return;
+
+  // Bound the quarantine by the memory it holds rather than by the number
+  // of blocks, so that many small releases cannot push a block out again
+  // right away.
+  unsigned sizeClass = getSizeClass(mo->size);
+  quarantine.push_back(std::make_pair(mo->address, sizeClass));
+  quarantineSize += 1ULL << (MinBlockBits + sizeClass);
+  while (quarantineSize > ((uint64_t) MemoryQuarantineSize << 20)) {
+    std::pair<uint64_t, unsigned> block = quarantine.front();
+    quarantine.pop_front();
+    quarantineSize -= 1ULL << (MinBlockBits + block.second);
+    freeLists[block.second].push_back(block.first);
+  }
 }
@@ -10,6 +10,8 @@
 #ifndef KLEE_MEMORYMANAGER_H
 #define KLEE_MEMORYMANAGER_H
 
+#include <deque>
+#include <map>
 #include <vector>
 #include <stdint.h>
 
@@ -20,19 +22,54 @@ namespace llvm {
 namespace klee {
   class MemoryObject;
 
+  /// MemoryManager - Hands out addresses for memory objects.
+  ///
+  /// Objects are carved out of a single reserved arena using power-of-two
+  /// size classes. Objects are reference counted by the states that hold
+  /// them; once the last reference is dropped the object's block is
+  /// quarantined for a while (so that dangling pointers are still caught as
+  /// invalid) and then recycled through the free list of its size class.
   class MemoryManager {
   private:
-    typedef std::vector<MemoryObject*> objects_ty;
+    /// Live objects, by address.
+    typedef std::map<uint64_t, MemoryObject*> objects_ty;
     objects_ty objects;
 
+    /// The reserved arena, and the number of bytes handed out from it so
+    /// far (not counting recycled blocks).
+    char *arena;
+    uint64_t arenaSize, arenaUsed;
+
+    /// Reusable arena blocks, indexed by size class.
+    std::vector< std::vector<uint64_t> > freeLists;
+
+    /// Released arena blocks (address, size class) in release order, which
+    /// may not be reused yet.
+    std::deque< std::pair<uint64_t, unsigned> > quarantine;
+
+    /// Total size of the blocks in the quarantine.
+    uint64_t quarantineSize;
+
+    /// Return a block of at least \a size bytes from the arena, or 0 if
+    /// the arena is exhausted.
+    uint64_t allocateFromArena(uint64_t size);
+
+    bool isArenaAddress(uint64_t address) const {
+      return arena && address >= (uint64_t) (unsigned long) arena &&
+        address < (uint64_t) (unsigned long) arena + arenaSize;
+    }
+
   public:
-    MemoryManager() {}
+    MemoryManager();
     ~MemoryManager();
 
     MemoryObject *allocate(uint64_t size, bool isLocal, bool isGlobal,
                            const llvm::Value *allocSite);
     MemoryObject *allocateFixed(uint64_t address, uint64_t size,
                                 const llvm::Value *allocSite);
+
+    /// Release the memory of an object that is no longer referenced by any
+    /// state. Called by the MemoryObject destructor.
     void deallocate(const MemoryObject *mo);
   };
 
@@ -9,9 +9,6 @@
 
 #include "PTree.h"
 
-#include <klee/Expr.h>
-#include <klee/util/ExprPPrinter.h>
-
 #include <vector>
 #include <iostream>
 
@@ -19,18 +16,49 @@ using namespace klee;
 
   /* *** */
 
-PTree::PTree(const data_type &_root) : root(new Node(0,_root)) {
+static const unsigned kNodesPerBlock = 1024;
+
+PTree::PTree(const data_type &_root) : freeNodes(0), blockUsed(kNodesPerBlock) {
+  root = allocate(0, _root);
 }
 
-PTree::~PTree() {}
+PTree::~PTree() {
+  for (std::vector<Node*>::iterator it = blocks.begin(), ie = blocks.end();
+       it != ie; ++it)
+    delete[] *it;
+}
+
+PTreeNode *PTree::allocate(Node *parent, const data_type &data) {
+  Node *n;
+  if (freeNodes) {
+    n = freeNodes;
+    freeNodes = n->parent;
+  } else {
+    if (blockUsed == kNodesPerBlock) {
+      blocks.push_back(new Node[kNodesPerBlock]);
+      blockUsed = 0;
+    }
+    n = &blocks.back()[blockUsed++];
+  }
+  n->parent = parent;
+  n->left = n->right = 0;
+  n->data = data;
+  n->skip = 0;
+  return n;
+}
+
+void PTree::release(Node *n) {
+  n->parent = freeNodes;
+  freeNodes = n;
+}
 
 std::pair<PTreeNode*, PTreeNode*>
 PTree::split(Node *n, 
              const data_type &leftData, 
              const data_type &rightData) {
   assert(n && !n->left && !n->right);
-  n->left = new Node(n, leftData);
-  n->right = new Node(n, rightData);
+  n->left = allocate(n, leftData);
+  n->right = allocate(n, rightData);
   return std::make_pair(n->left, n->right);
 }
 
@@ -38,7 +66,6 @@ void PTree::remove(Node *n) {
   assert(!n->left && !n->right);
   do {
     Node *p = n->parent;
-    delete n;
     if (p) {
       if (n == p->left) {
         p->left = 0;
@@ -47,13 +74,19 @@ void PTree::remove(Node *n) {
         p->right = 0;
       }
     }
+    release(n);
     n = p;
   } while (n && !n->left && !n->right);
+
+  // n lost a child but still has the other one.
+  if (n) {
+    Node *child = n->left ? n->left : n->right;
+    n->skip = (child->left && child->right) || child->data || !child->skip
+      ? child : child->skip;
+  }
 }
 
 void PTree::dump(std::ostream &os) {
-  ExprPPrinter *pp = ExprPPrinter::create(os);
-  pp->setNewline("\\l");
   os << "digraph G {\n";
   os << "\tsize=\"10,7.5\";\n";
   os << "\tratio=fill;\n";
@@ -66,13 +99,7 @@ void PTree::dump(std::ostream &os) {
   while (!stack.empty()) {
     PTree::Node *n = stack.back();
     stack.pop_back();
-    if (n->condition.isNull()) {
-      os << "\tn" << n << " [label=\"\"";
-    } else {
-      os << "\tn" << n << " [label=\"";
-      pp->print(n->condition);
-      os << "\",shape=diamond";
-    }
+    os << "\tn" << n << " [label=\"\"";
     if (n->data)
       os << ",fillcolor=green";
     os << "];\n";
@@ -86,18 +113,4 @@ void PTree::dump(std::ostream &os) {
     }
   }
   os << "}\n";
-  delete pp;
-}
-
-PTreeNode::PTreeNode(PTreeNode *_parent, 
-                     ExecutionState *_data) 
-  : parent(_parent),
-    left(0),
-    right(0),
-    data(_data),
-    condition(0) {
-}
-
-PTreeNode::~PTreeNode() {
 }
-
@@ -10,11 +10,10 @@
 #ifndef __UTIL_PTREE_H__
 #define __UTIL_PTREE_H__
 
-#include <klee/Expr.h>
-
 #include <utility>
 #include <cassert>
 #include <iostream>
+#include <vector>
 
 namespace klee {
   class ExecutionState;
@@ -35,6 +34,17 @@ namespace klee {
     void remove(Node *n);
 
     void dump(std::ostream &os);
+
+  private:
+    /// Nodes are carved out of blocks and recycled through a free list
+    /// (linked through the parent field) instead of being allocated one
+    /// by one.
+    std::vector<Node*> blocks;
+    Node *freeNodes;
+    unsigned blockUsed;
+
+    Node *allocate(Node *parent, const data_type &data);
+    void release(Node *n);
   };
 
   class PTreeNode {
@@ -42,11 +52,15 @@ namespace klee {
   public:
     PTreeNode *parent, *left, *right;
     ExecutionState *data;
-    ref<Expr> condition;
+
+    /// For a node left with a single child, a descendant on the path below
+    /// it which has a state or two children, so that walks down the tree
+    /// can skip over chains of single-child nodes. (The chain itself is
+    /// kept: it records the branch decisions of the states below.)
+    PTreeNode *skip;
 
   private:
-    PTreeNode(PTreeNode *_parent, ExecutionState *_data);
-    ~PTreeNode();
+    PTreeNode() {}
   };
 }
 
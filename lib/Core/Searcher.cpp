@@ -89,7 +89,12 @@ void DFSSearcher::update(ExecutionState *current,
 ///
 
 ExecutionState &RandomSearcher::selectState() {
-  return *states[theRNG.getInt32()%states.size()];
+  ExecutionState *es = states[theRNG.getInt32()%states.size()];
+  // Make two pulls to try and pick a resident state, which does not have
+  // to be rebuilt before it runs.
+  if (!es->resident)
+    es = states[theRNG.getInt32()%states.size()];
+  return *es;
 }
 
 void RandomSearcher::update(ExecutionState *current,
@@ -144,7 +149,11 @@ WeightedRandomSearcher::~WeightedRandomSearcher() {
 }
 
 ExecutionState &WeightedRandomSearcher::selectState() {
-  return *states->choose(theRNG.getDoubleL());
+  ExecutionState *es = states->choose(theRNG.getDoubleL());
+  // Make two pulls to try and pick a resident state.
+  if (!es->resident)
+    es = states->choose(theRNG.getDoubleL());
+  return *es;
 }
 
 double WeightedRandomSearcher::getWeight(ExecutionState *es) {
@@ -159,6 +168,9 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
     return inv * inv;
   }
   case CPInstCount: {
+    // Evicted states keep no stack.
+    if (es->stack.empty())
+      return 1.;
     StackFrame &sf = es->stack.back();
     uint64_t count = sf.callPathNode->statistics.getValue(stats::instructions);
     double inv = 1. / std::max((uint64_t) 1, count);
@@ -169,6 +181,7 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   case CoveringNew:
   case MinDistToUncovered: {
     uint64_t md2u = computeMinDistToUncovered(es->pc,
+                                              es->stack.empty() ? 0 :
                                               es->stack.back().minDistToUncoveredOnReturn);
 
     double invMD2U = 1. / (md2u ? md2u : 10000);
@@ -216,14 +229,20 @@ RandomPathSearcher::~RandomPathSearcher() {
 }
 
 ExecutionState &RandomPathSearcher::selectState() {
+  ExecutionState *es = selectPath();
+  // Make two walks to try and pick a resident state.
+  if (!es->resident)
+    es = selectPath();
+  return *es;
+}
+
+ExecutionState *RandomPathSearcher::selectPath() {
   unsigned flips=0, bits=0;
   PTree::Node *n = executor.processTree->root;
   
   while (!n->data) {
-    if (!n->left) {
-      n = n->right;
-    } else if (!n->right) {
-      n = n->left;
+    if (!n->left || !n->right) {
+      n = n->skip ? n->skip : (n->left ? n->left : n->right);
     } else {
       if (bits==0) {
         flips = theRNG.getInt32();
@@ -234,7 +253,7 @@ ExecutionState &RandomPathSearcher::selectState() {
     }
   }
 
-  return *n->data;
+  return n->data;
 }
 
 void RandomPathSearcher::update(ExecutionState *current,
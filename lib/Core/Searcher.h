@@ -141,6 +141,10 @@ namespace klee {
   class RandomPathSearcher : public Searcher {
     Executor &executor;
 
+    /// Walk down the process tree taking random branches and return the
+    /// state at the leaf reached.
+    ExecutionState *selectPath();
+
   public:
     RandomPathSearcher(Executor &_executor);
     ~RandomPathSearcher();
@@ -195,7 +195,7 @@ SpecialFunctionHandler::readStringAtAddress(ExecutionState &state,
                                      res) &&
          res &&
          "XXX interior pointer unhandled");
-  const MemoryObject *mo = op.first;
+  const MemoryObject *mo = op.first.get();
   const ObjectState *os = op.second;
 
   char *buf = new char[mo->size];
@@ -672,7 +672,7 @@ void SpecialFunctionHandler::handleMakeSymbolic(ExecutionState &state,
   
   for (Executor::ExactResolutionList::iterator it = rl.begin(), 
          ie = rl.end(); it != ie; ++it) {
-    const MemoryObject *mo = it->first.first;
+    const MemoryObject *mo = it->first.first.get();
     mo->setName(name);
     
     const ObjectState *old = it->first.second;
@@ -716,7 +716,7 @@ void SpecialFunctionHandler::handleMarkGlobal(ExecutionState &state,
   
   for (Executor::ExactResolutionList::iterator it = rl.begin(), 
          ie = rl.end(); it != ie; ++it) {
-    const MemoryObject *mo = it->first.first;
+    const MemoryObject *mo = it->first.first.get();
     assert(!mo->isLocal);
     mo->isGlobal = true;
   }
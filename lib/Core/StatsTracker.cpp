@@ -38,8 +38,10 @@
 #include "llvm/System/Process.h"
 #include "llvm/System/Path.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <queue>
 
 using namespace klee;
 using namespace llvm;
@@ -231,8 +233,11 @@ StatsTracker::~StatsTracker() {
 void StatsTracker::done() {
   if (statsFile)
     writeStatsLine();
-  if (OutputIStats)
+  if (OutputIStats) {
     writeIStats();
+    if (!executor.kmodule->simdNames.empty())
+      writeSIMDSummary();
+  }
 }
 
 void StatsTracker::stepInstruction(ExecutionState &es) {
@@ -262,6 +267,9 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
     if (UseCallPaths)
       theStatisticManager->setContext(&sf.callPathNode->statistics);
 
+    if (es.pc->simdIndex >= 0)
+      ++stats::simdInstructions;
+
     if (es.instsSinceCovNew)
       ++es.instsSinceCovNew;
 
@@ -280,11 +288,24 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
 	stats::uncoveredInstructions += (uint64_t)-1;
+        if (updateMinDistToUncovered)
+          newlyCovered.push_back(ii.id);
       }
     }
   }
 }
 
+void StatsTracker::markCovered(unsigned id) {
+  if (theStatisticManager->getIndexedValue(stats::coveredInstructions, id))
+    return;
+
+  theStatisticManager->setIndex(id);
+  ++stats::coveredInstructions;
+  stats::uncoveredInstructions += (uint64_t)-1;
+  if (updateMinDistToUncovered)
+    newlyCovered.push_back(id);
+}
+
 ///
 
 /* Should be called _after_ the es->pushFrame() */
@@ -361,6 +382,7 @@ void StatsTracker::writeStatsHeader() {
              << "'CexCacheTime',"
              << "'ForkTime',"
              << "'ResolveTime',"
+             << "'PrunedStates',"
              << ")\n";
   statsFile->flush();
 }
@@ -388,6 +410,7 @@ void StatsTracker::writeStatsLine() {
              << "," << stats::cexCacheTime / 1000000.
              << "," << stats::forkTime / 1000000.
              << "," << stats::resolveTime / 1000000.
+             << "," << stats::prunedStates
              << ")\n";
   statsFile->flush();
 }
@@ -398,11 +421,43 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
     ExecutionState &state = **it;
     const InstructionInfo &ii = *state.pc->info;
     theStatisticManager->incrementIndexedValue(stats::states, ii.id, addend);
-    if (UseCallPaths)
+    if (UseCallPaths && !state.stack.empty())
       state.stack.back().callPathNode->statistics.incrementValue(stats::states, addend);
   }
 }
 
+/// Write the number of executions of each kind of SIMD operation, most
+/// frequent first.
+void StatsTracker::writeSIMDSummary() {
+  KModule *km = executor.kmodule;
+  std::vector<uint64_t> counts(km->simdNames.size());
+  for (std::vector<KFunction*>::iterator it = km->functions.begin(), 
+         ie = km->functions.end(); it != ie; ++it) {
+    KFunction *kf = *it;
+    for (unsigned i=0; i<kf->numInstructions; ++i) {
+      KInstruction *ki = kf->instructions[i];
+      if (ki->simdIndex >= 0)
+        counts[ki->simdIndex] += 
+          theStatisticManager->getIndexedValue(stats::simdInstructions,
+                                               ki->info->id);
+    }
+  }
+
+  std::vector< std::pair<uint64_t, std::string> > summary;
+  for (unsigned i=0; i<counts.size(); ++i)
+    summary.push_back(std::make_pair(counts[i], km->simdNames[i]));
+  std::sort(summary.rbegin(), summary.rend());
+
+  std::ostream *os = executor.interpreterHandler->openOutputFile("run.simd");
+  if (!os) {
+    klee_warning("unable to write SIMD summary");
+    return;
+  }
+  for (unsigned i=0; i<summary.size(); ++i)
+    *os << summary[i].second << " " << summary[i].first << "\n";
+  delete os;
+}
+
 void StatsTracker::writeIStats() {
   Module *m = executor.kmodule->module;
   uint64_t istatsMask = 0;
@@ -435,6 +490,8 @@ void StatsTracker::writeIStats() {
   istatsMask |= 1<<sm.getStatisticID("UncoveredInstructions");
   istatsMask |= 1<<sm.getStatisticID("States");
   istatsMask |= 1<<sm.getStatisticID("MinDistToUncovered");
+  if (!executor.kmodule->simdNames.empty())
+    istatsMask |= 1<<sm.getStatisticID("SIMDInstructions");
 
   of << "positions: instr line\n";
 
@@ -567,6 +624,168 @@ static std::vector<Instruction*> getSuccs(Instruction *i) {
   return res;
 }
 
+/// Edges of the min-distance-to-uncovered graph, indexed by instruction
+/// id. An edge (w, c) of u means that u is at distance c plus that of w.
+typedef std::vector< std::vector< std::pair<unsigned, unsigned> > > distgraph_ty;
+
+static distgraph_ty distSuccs, distPreds;
+
+static void buildDistanceGraph(Module *m, const InstructionInfoTable &infos) {
+  distSuccs.resize(infos.getMaxID());
+  distPreds.resize(infos.getMaxID());
+
+  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
+       fnIt != fn_ie; ++fnIt) {
+    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
+         bbIt != bb_ie; ++bbIt) {
+      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
+           it != ie; ++it) {
+        Instruction *inst = it;
+        unsigned id = infos.getInfo(inst).id;
+        unsigned bestThrough = 0;
+
+        if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
+          std::vector<Function*> &targets = callTargets[inst];
+          for (std::vector<Function*>::iterator fnIt = targets.begin(),
+                 ie = targets.end(); fnIt != ie; ++fnIt) {
+            uint64_t dist = functionShortestPath[*fnIt];
+            if (dist) {
+              dist = 1+dist; // count instruction itself
+              if (bestThrough==0 || dist<bestThrough)
+                bestThrough = dist;
+            }
+
+            if (!(*fnIt)->isDeclaration())
+              distSuccs[id].push_back(std::make_pair(infos.getFunctionInfo(*fnIt).id,
+                                                     1));
+          }
+        } else {
+          bestThrough = 1;
+        }
+
+        if (bestThrough) {
+          std::vector<Instruction*> succs = getSuccs(inst);
+          for (std::vector<Instruction*>::iterator it2 = succs.begin(),
+                 ie = succs.end(); it2 != ie; ++it2)
+            distSuccs[id].push_back(std::make_pair(infos.getInfo(*it2).id,
+                                                   bestThrough));
+        }
+      }
+    }
+  }
+
+  for (unsigned id = 0, e = distSuccs.size(); id != e; ++id)
+    for (unsigned i = 0, n = distSuccs[id].size(); i != n; ++i)
+      distPreds[distSuccs[id][i].first].push_back(std::make_pair(id,
+                                                  distSuccs[id][i].second));
+}
+
+/// Lower minDistToUncovered along the predecessors of the given
+/// instructions, whose distances must be final. If \arg region is non-null,
+/// only instructions in it are updated.
+static void propagateDistances(const std::vector<unsigned> &sources,
+                               const std::vector<bool> *region) {
+  StatisticManager &sm = *theStatisticManager;
+  typedef std::pair<uint64_t, unsigned> entry_ty;
+  std::priority_queue<entry_ty, std::vector<entry_ty>,
+                      std::greater<entry_ty> > queue;
+
+  for (std::vector<unsigned>::const_iterator it = sources.begin(),
+         ie = sources.end(); it != ie; ++it)
+    queue.push(std::make_pair(sm.getIndexedValue(stats::minDistToUncovered, *it),
+                              *it));
+
+  while (!queue.empty()) {
+    entry_ty top = queue.top();
+    queue.pop();
+    if (top.first != sm.getIndexedValue(stats::minDistToUncovered, top.second))
+      continue;
+
+    std::vector< std::pair<unsigned, unsigned> > &preds = distPreds[top.second];
+    for (unsigned i = 0, e = preds.size(); i != e; ++i) {
+      unsigned pred = preds[i].first;
+      if (region && !(*region)[pred])
+        continue;
+
+      uint64_t dist = top.first + preds[i].second;
+      uint64_t cur = sm.getIndexedValue(stats::minDistToUncovered, pred);
+      if (cur==0 || dist<cur) {
+        sm.setIndexedValue(stats::minDistToUncovered, pred, dist);
+        queue.push(std::make_pair(dist, pred));
+      }
+    }
+  }
+}
+
+/// Recompute minDistToUncovered after the given instructions were covered.
+/// Distances can only grow, and only for instructions whose every shortest
+/// path ran through a covered one; those are found first and then solved
+/// from the unaffected instructions around them.
+static void updateDistances(const std::vector<unsigned> &covered) {
+  StatisticManager &sm = *theStatisticManager;
+  std::vector<bool> affected(distSuccs.size());
+  std::vector<unsigned> region, worklist(covered);
+
+  while (!worklist.empty()) {
+    unsigned id = worklist.back();
+    worklist.pop_back();
+    if (affected[id])
+      continue;
+
+    uint64_t cur = sm.getIndexedValue(stats::minDistToUncovered, id);
+    if (!cur)
+      continue;
+
+    // Still supported by being uncovered itself or by an unaffected
+    // successor on a shortest path?
+    bool supported = sm.getIndexedValue(stats::uncoveredInstructions, id);
+    std::vector< std::pair<unsigned, unsigned> > &succs = distSuccs[id];
+    for (unsigned i = 0, e = succs.size(); !supported && i != e; ++i) {
+      unsigned succ = succs[i].first;
+      uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered, succ);
+      supported = !affected[succ] && dist && dist + succs[i].second == cur;
+    }
+    if (supported)
+      continue;
+
+    affected[id] = true;
+    region.push_back(id);
+
+    std::vector< std::pair<unsigned, unsigned> > &preds = distPreds[id];
+    for (unsigned i = 0, e = preds.size(); i != e; ++i) {
+      unsigned pred = preds[i].first;
+      if (!affected[pred] &&
+          sm.getIndexedValue(stats::minDistToUncovered, pred) ==
+          cur + preds[i].second)
+        worklist.push_back(pred);
+    }
+  }
+
+  // Restart the affected region from its unaffected successors.
+  for (std::vector<unsigned>::iterator it = region.begin(), ie = region.end();
+       it != ie; ++it) {
+    uint64_t best = 0;
+    std::vector< std::pair<unsigned, unsigned> > &succs = distSuccs[*it];
+    for (unsigned i = 0, e = succs.size(); i != e; ++i) {
+      unsigned succ = succs[i].first;
+      uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered, succ);
+      if (!affected[succ] && dist) {
+        dist += succs[i].second;
+        if (best==0 || dist<best)
+          best = dist;
+      }
+    }
+    sm.setIndexedValue(stats::minDistToUncovered, *it, best);
+  }
+
+  std::vector<unsigned> sources;
+  for (std::vector<unsigned>::iterator it = region.begin(), ie = region.end();
+       it != ie; ++it)
+    if (sm.getIndexedValue(stats::minDistToUncovered, *it))
+      sources.push_back(*it);
+  propagateDistances(sources, &affected);
+}
+
 uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
                                          uint64_t minDistAtRA) {
   StatisticManager &sm = *theStatisticManager;
@@ -607,7 +826,7 @@ void StatsTracker::computeReachableUncovered() {
       for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
            bbIt != bb_ie; ++bbIt) {
         for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-             it != it; ++it) {
+             it != ie; ++it) {
           if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
             CallSite cs(it);
             if (isa<InlineAsm>(cs.getCalledValue())) {
@@ -653,7 +872,7 @@ void StatsTracker::computeReachableUncovered() {
       for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
            bbIt != bb_ie; ++bbIt) {
         for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-             it != it; ++it) {
+             it != ie; ++it) {
           instructions.push_back(it);
           unsigned id = infos.getInfo(it).id;
           sm.setIndexedValue(stats::minDistToReturn, 
@@ -717,84 +936,22 @@ void StatsTracker::computeReachableUncovered() {
     } while (changed);
   }
 
-  // compute minDistToUncovered, 0 is unreachable
-  std::vector<Instruction *> instructions;
-  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-       fnIt != fn_ie; ++fnIt) {
-    // Not sure if I should bother to preorder here.
-    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-         bbIt != bb_ie; ++bbIt) {
-      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-           it != it; ++it) {
-        unsigned id = infos.getInfo(it).id;
-        instructions.push_back(&*it);
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           id, 
-                           sm.getIndexedValue(stats::uncoveredInstructions, id));
-      }
-    }
-  }
-  
-  std::reverse(instructions.begin(), instructions.end());
-  
-  // I'm so lazy it's not even worklisted.
-  bool changed;
-  do {
-    changed = false;
-    for (std::vector<Instruction*>::iterator it = instructions.begin(),
-           ie = instructions.end(); it != ie; ++it) {
-      Instruction *inst = *it;
-      uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered, 
-                                                     infos.getInfo(inst).id);
-      unsigned bestThrough = 0;
-      
-      if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
-        std::vector<Function*> &targets = callTargets[inst];
-        for (std::vector<Function*>::iterator fnIt = targets.begin(),
-               ie = targets.end(); fnIt != ie; ++fnIt) {
-          uint64_t dist = functionShortestPath[*fnIt];
-          if (dist) {
-            dist = 1+dist; // count instruction itself
-            if (bestThrough==0 || dist<bestThrough)
-              bestThrough = dist;
-          }
+  if (distSuccs.empty()) {
+    buildDistanceGraph(m, infos);
 
-          if (!(*fnIt)->isDeclaration()) {
-            uint64_t calleeDist = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getFunctionInfo(*fnIt).id);
-            if (calleeDist) {
-              calleeDist = 1+calleeDist; // count instruction itself
-              if (best==0 || calleeDist<best)
-                best = calleeDist;
-            }
-          }
-        }
-      } else {
-        bestThrough = 1;
-      }
-      
-      if (bestThrough) {
-        std::vector<Instruction*> succs = getSuccs(inst);
-        for (std::vector<Instruction*>::iterator it2 = succs.begin(),
-               ie = succs.end(); it2 != ie; ++it2) {
-          uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*it2).id);
-          if (dist) {
-            uint64_t val = bestThrough + dist;
-            if (best==0 || val<best)
-              best = val;
-          }
-        }
-      }
-
-      if (best != cur) {
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           infos.getInfo(inst).id, 
-                           best);
-        changed = true;
-      }
+    // compute minDistToUncovered from scratch, 0 is unreachable
+    std::vector<unsigned> sources;
+    for (unsigned id = 0, e = distSuccs.size(); id != e; ++id) {
+      uint64_t uncovered = sm.getIndexedValue(stats::uncoveredInstructions, id);
+      sm.setIndexedValue(stats::minDistToUncovered, id, uncovered);
+      if (uncovered)
+        sources.push_back(id);
     }
-  } while (changed);
+    propagateDistances(sources, 0);
+  } else if (!newlyCovered.empty()) {
+    updateDistances(newlyCovered);
+  }
+  newlyCovered.clear();
 
   for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
@@ -14,6 +14,7 @@
 
 #include <iostream>
 #include <set>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -46,6 +47,9 @@ namespace klee {
 
     bool updateMinDistToUncovered;
 
+    /// Instructions covered since minDistToUncovered was last updated.
+    std::vector<unsigned> newlyCovered;
+
   public:
     static bool useStatistics();
 
@@ -54,6 +58,7 @@ namespace klee {
     void writeStatsHeader();
     void writeStatsLine();
     void writeIStats();
+    void writeSIMDSummary();
 
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
@@ -83,6 +88,10 @@ namespace klee {
     double elapsed();
 
     void computeReachableUncovered();
+
+    /// Mark the instruction with the given id as covered without a state
+    /// reaching it, e.g. when resuming from a checkpoint.
+    void markCovered(unsigned id);
   };
 
   uint64_t computeMinDistToUncovered(const KInstruction *ki,
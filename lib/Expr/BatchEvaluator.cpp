@@ -0,0 +1,331 @@
+//===-- BatchEvaluator.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/BatchEvaluator.h"
+
+#include "klee/util/Assignment.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+/// The number of assignments evaluated together, chosen so that the values
+/// of a block stay in cache.
+static const unsigned BlockSize = 256;
+
+static inline uint64_t widthMask(Expr::Width w) {
+  return w >= 64 ? ~0ULL : (1ULL << w) - 1;
+}
+
+static inline int64_t signExtend(uint64_t v, Expr::Width w) {
+  return w >= 64 ? (int64_t) v : ((int64_t) (v << (64 - w))) >> (64 - w);
+}
+
+BatchEvaluator::BatchEvaluator(const ref<Expr> &e)
+  : roots(1, e), valid(true), numLanes(0), stride(0) {
+  ExprHashMap<unsigned> slots;
+  rootSlots.push_back(compile(e, slots));
+}
+
+BatchEvaluator::BatchEvaluator(const std::vector< ref<Expr> > &_roots)
+  : roots(_roots), valid(true), numLanes(0), stride(0) {
+  ExprHashMap<unsigned> slots;
+  for (std::vector< ref<Expr> >::const_iterator it = roots.begin(),
+         ie = roots.end(); it != ie; ++it)
+    rootSlots.push_back(compile(*it, slots));
+}
+
+/// compile - Append the instructions computing \arg e to the tape, after
+/// those of its operands, and return the slot holding its value.
+unsigned BatchEvaluator::compile(const ref<Expr> &e,
+                                 ExprHashMap<unsigned> &slots) {
+  ExprHashMap<unsigned>::iterator it = slots.find(e);
+  if (it != slots.end())
+    return it->second;
+
+  if (!valid || e->getWidth() > 64) {
+    valid = false;
+    return 0;
+  }
+
+  Instruction inst;
+  inst.kind = e->getKind();
+  inst.width = e->getWidth();
+  inst.numKids = 0;
+  inst.value = 0;
+  inst.expr = e.get();
+  inst.array = inst.firstUpdate = inst.numUpdates = 0;
+
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+    inst.value = CE->getZExtValue();
+  } else if (ReadExpr *RE = dyn_cast<ReadExpr>(e)) {
+    inst.numKids = 1;
+    inst.kids[0] = compile(RE->index, slots);
+
+    std::vector<unsigned> pairs;
+    for (const UpdateNode *un = RE->updates.head; un; un = un->next) {
+      pairs.push_back(compile(un->index, slots));
+      pairs.push_back(compile(un->value, slots));
+    }
+    inst.firstUpdate = updates.size();
+    inst.numUpdates = pairs.size() / 2;
+    updates.insert(updates.end(), pairs.begin(), pairs.end());
+
+    const Array *root = RE->updates.root;
+    inst.array = std::find(arrays.begin(), arrays.end(), root) - arrays.begin();
+    if (inst.array == arrays.size())
+      arrays.push_back(root);
+  } else {
+    inst.numKids = e->getNumKids();
+    assert(inst.numKids <= 3 && "unexpected number of kids");
+    for (unsigned i = 0; i != inst.numKids; ++i)
+      inst.kids[i] = compile(e->getKid(i), slots);
+    if (ExtractExpr *EE = dyn_cast<ExtractExpr>(e))
+      inst.value = EE->offset;
+  }
+
+  if (!valid)
+    return 0;
+
+  unsigned slot = tape.size();
+  tape.push_back(inst);
+  slots.insert(std::make_pair(e, slot));
+  return slot;
+}
+
+void BatchEvaluator::evaluate(const std::vector<const Assignment*> &assignments) {
+  numLanes = assignments.size();
+  results.assign(roots.size() * numLanes, 0);
+  determined.assign(numLanes, false);
+  if (!valid || !numLanes)
+    return;
+
+  // There are often only a handful of lanes (one per seed), so the buffers
+  // are sized for the lanes evaluated, up to a block.
+  stride = std::min(BlockSize, numLanes);
+  std::vector<uint64_t> values(tape.size() * stride);
+  std::vector<unsigned char> ok(stride);
+  for (unsigned base = 0; base < numLanes; base += stride) {
+    unsigned count = std::min(stride, numLanes - base);
+    evaluateBlock(&assignments[base], count, values, ok);
+
+    for (unsigned j = 0; j != count; ++j) {
+      determined[base + j] = ok[j];
+      for (unsigned i = 0, e = rootSlots.size(); i != e; ++i)
+        results[i*numLanes + base + j] = values[rootSlots[i]*stride + j];
+    }
+  }
+}
+
+/// evaluateBlock - Run the tape over \arg count assignments. The values of
+/// slot s for assignment j are left in values[s*stride + j], and ok[j] is
+/// cleared if some value under assignment j is not a constant.
+void BatchEvaluator::evaluateBlock(const Assignment *const *assignments,
+                                   unsigned count,
+                                   std::vector<uint64_t> &values,
+                                   std::vector<unsigned char> &ok) {
+  std::fill(ok.begin(), ok.begin() + count, 1);
+
+  // Look up the bindings of each array once per block.
+  std::vector<const std::vector<unsigned char>*> bound(arrays.size() * count);
+  for (unsigned a = 0, e = arrays.size(); a != e; ++a) {
+    for (unsigned j = 0; j != count; ++j) {
+      Assignment::bindings_ty::const_iterator it =
+        assignments[j]->bindings.find(arrays[a]);
+      if (it != assignments[j]->bindings.end())
+        bound[a*count + j] = &it->second;
+    }
+  }
+
+  for (unsigned s = 0, se = tape.size(); s != se; ++s) {
+    const Instruction &inst = tape[s];
+    uint64_t *out = &values[s*stride];
+    const uint64_t *a = 0, *b = 0, *c = 0;
+    if (inst.numKids > 0) a = &values[inst.kids[0]*stride];
+    if (inst.numKids > 1) b = &values[inst.kids[1]*stride];
+    if (inst.numKids > 2) c = &values[inst.kids[2]*stride];
+    Expr::Width w = inst.width;
+    uint64_t m = widthMask(w);
+
+    switch (inst.kind) {
+    case Expr::Constant:
+      std::fill(out, out + count, inst.value);
+      break;
+
+    case Expr::NotOptimized:
+    case Expr::ZExt:
+      std::copy(a, a + count, out);
+      break;
+
+    case Expr::Read: {
+      const Array *root = arrays[inst.array];
+      const std::vector<unsigned char> *const *laneBindings =
+        &bound[inst.array*count];
+      const unsigned *pairs = inst.numUpdates ? &updates[inst.firstUpdate] : 0;
+      for (unsigned j = 0; j != count; ++j) {
+        uint64_t index = a[j], v = 0;
+        unsigned u = 0;
+        for (; u != inst.numUpdates; ++u) {
+          if (values[pairs[2*u]*stride + j] == index) {
+            v = values[pairs[2*u+1]*stride + j];
+            break;
+          }
+        }
+        if (u == inst.numUpdates) {
+          if (root->isConstantArray() && index < root->size)
+            v = root->constantValues[index]->getZExtValue();
+          else if (laneBindings[j] && index < laneBindings[j]->size())
+            v = (*laneBindings[j])[index];
+          else if (assignments[j]->allowFreeValues)
+            ok[j] = 0;
+        }
+        out[j] = v;
+      }
+      break;
+    }
+
+    case Expr::Select:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] ? b[j] : c[j];
+      break;
+
+    case Expr::Concat: {
+      unsigned shift = tape[inst.kids[1]].width;
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = (a[j] << shift) | b[j];
+      break;
+    }
+
+    case Expr::Extract:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = (a[j] >> inst.value) & m;
+      break;
+
+    case Expr::SExt: {
+      Expr::Width from = tape[inst.kids[0]].width;
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = (uint64_t) signExtend(a[j], from) & m;
+      break;
+    }
+
+    case Expr::Add:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = (a[j] + b[j]) & m;
+      break;
+    case Expr::Sub:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = (a[j] - b[j]) & m;
+      break;
+    case Expr::Mul:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = (a[j] * b[j]) & m;
+      break;
+
+    case Expr::Not:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = ~a[j] & m;
+      break;
+    case Expr::And:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] & b[j];
+      break;
+    case Expr::Or:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] | b[j];
+      break;
+    case Expr::Xor:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] ^ b[j];
+      break;
+
+    // Shifts by at least the width behave as APInt does.
+    case Expr::Shl:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = b[j] >= w ? 0 : (a[j] << b[j]) & m;
+      break;
+    case Expr::LShr:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = b[j] >= w ? 0 : a[j] >> b[j];
+      break;
+    case Expr::AShr:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = (uint64_t) (signExtend(a[j], w) >>
+                             (b[j] >= w ? w - 1 : b[j])) & m;
+      break;
+
+    case Expr::Eq:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] == b[j];
+      break;
+    case Expr::Ne:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] != b[j];
+      break;
+    case Expr::Ult:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] < b[j];
+      break;
+    case Expr::Ule:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] <= b[j];
+      break;
+    case Expr::Ugt:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] > b[j];
+      break;
+    case Expr::Uge:
+      for (unsigned j = 0; j != count; ++j)
+        out[j] = a[j] >= b[j];
+      break;
+    case Expr::Slt:
+    case Expr::Sle:
+    case Expr::Sgt:
+    case Expr::Sge: {
+      Expr::Width from = tape[inst.kids[0]].width;
+      for (unsigned j = 0; j != count; ++j) {
+        int64_t l = signExtend(a[j], from), r = signExtend(b[j], from);
+        switch (inst.kind) {
+        case Expr::Slt: out[j] = l < r; break;
+        case Expr::Sle: out[j] = l <= r; break;
+        case Expr::Sgt: out[j] = l > r; break;
+        default:        out[j] = l >= r; break;
+        }
+      }
+      break;
+    }
+
+    default: {
+      // Everything else, in particular division and the floating point
+      // operations, goes through the constant folder one lane at a time.
+      bool isDiv = inst.kind == Expr::UDiv || inst.kind == Expr::SDiv ||
+                   inst.kind == Expr::URem || inst.kind == Expr::SRem;
+      for (unsigned j = 0; j != count; ++j) {
+        out[j] = 0;
+        if (!ok[j])
+          continue;
+        if (isDiv && !b[j]) {
+          ok[j] = 0;
+          continue;
+        }
+
+        ref<Expr> kids[3];
+        for (unsigned k = 0; k != inst.numKids; ++k)
+          kids[k] = ConstantExpr::create(values[inst.kids[k]*stride + j],
+                                         tape[inst.kids[k]].width);
+        ref<Expr> res = inst.expr->rebuild(kids);
+        if (ConstantExpr *CE = dyn_cast<ConstantExpr>(res))
+          out[j] = CE->getZExtValue();
+        else
+          ok[j] = 0;
+      }
+      break;
+    }
+    }
+  }
+}
@@ -14,6 +14,7 @@
 
 #include <iostream>
 #include <map>
+#include <vector>
 
 using namespace klee;
 
@@ -62,24 +63,38 @@ public:
 };
 
 bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
-  ConstraintManager::constraints_ty old;
-  bool changed = false;
-
-  constraints.swap(old);
-  for (ConstraintManager::constraints_ty::iterator 
-         it = old.begin(), ie = old.end(); it != ie; ++it) {
-    ref<Expr> &ce = *it;
+  // Visit the constraints in the order they were added.
+  std::vector<Node*> old(numConstraints);
+  Node *n = head;
+  for (unsigned i = numConstraints; i--; n = n->next)
+    old[i] = n;
+
+  // The constraints before the first one the visitor rewrites stay shared.
+  unsigned first = 0;
+  for (; first != old.size(); ++first)
+    if (visitor.visit(old[first]->expr) != old[first]->expr)
+      break;
+  if (first == old.size())
+    return false;
+
+  Node *oldHead = head;
+  head = first ? old[first - 1] : 0;
+  if (head)
+    ++head->refCount;
+  numConstraints = first;
+  for (unsigned i = first; i != old.size(); ++i) {
+    ref<Expr> ce = old[i]->expr;
     ref<Expr> e = visitor.visit(ce);
 
     if (e!=ce) {
       addConstraintInternal(e); // enable further reductions
-      changed = true;
     } else {
-      constraints.push_back(ce);
+      push(ce);
     }
   }
+  release(oldHead);
 
-  return changed;
+  return true;
 }
 
 void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
@@ -92,8 +107,7 @@ ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
 
   std::map< ref<Expr>, ref<Expr> > equalities;
   
-  for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
+  for (const_iterator it = begin(), ie = end(); it != ie; ++it) {
     if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
       if (isa<ConstantExpr>(ee->left)) {
         equalities.insert(std::make_pair(ee->right,
@@ -140,12 +154,12 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
       ExprReplaceVisitor visitor(be->right, be->left);
       rewriteConstraints(visitor);
     }
-    constraints.push_back(e);
+    push(e);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    push(e);
     break;
   }
 }
@@ -155,9 +169,22 @@ void ConstraintManager::addConstraint(ref<Expr> e) {
   addConstraintInternal(e);
 }
 
+bool ConstraintManager::operator==(const ConstraintManager &other) const {
+  if (numConstraints != other.numConstraints)
+    return false;
+
+  // Shared tails are equal.
+  for (const Node *a = head, *b = other.head; a != b; a = a->next, b = b->next)
+    if (a->expr != b->expr)
+      return false;
+  return true;
+}
+
 void ConstraintManager::dump(std::ostream &out) const {
+  std::vector< ref<Expr> > ordered(begin(), end());
   int count = 0;
-  for (const_iterator i = constraints.begin(); i != constraints.end(); ++i) {
+  for (std::vector< ref<Expr> >::reverse_iterator i = ordered.rbegin(),
+         ie = ordered.rend(); i != ie; ++i) {
     out << ++count << ". ";
     (*i)->print(out);
     out << std::endl;
@@ -687,6 +687,16 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
     }
   }
 
+  // If every update was provably to a different index, a constant read of a
+  // constant array folds to the initial value.
+  if (!un && ul.root && ul.root->isConstantArray()) {
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(index)) {
+      uint64_t idx = CE->getZExtValue();
+      if (idx < ul.root->size)
+        return ul.root->constantValues[idx];
+    }
+  }
+
   return ReadExpr::alloc(ul, index);
 }
 
@@ -746,6 +756,13 @@ ref<Expr> ConcatExpr::create(const ref<Expr> &l, const ref<Expr> &r) {
         return ConcatExpr::create(lCE->Concat(rlCE), rCE->getKid(1));
   }
 
+  // Merge Concat(Concat(_, Constant), Constant)
+  //    -> Concat(_, Concat(Constant, Constant))
+  if (ConstantExpr *rCE = dyn_cast<ConstantExpr>(r))
+    if (ConcatExpr *lCE = dyn_cast<ConcatExpr>(l))
+      if (ConstantExpr *lrCE = dyn_cast<ConstantExpr>(lCE->getKid(1)))
+        return ConcatExpr::create(lCE->getKid(0), lrCE->Concat(rCE));
+
   if (SelectExpr *lSE = dyn_cast<SelectExpr>(l)) {
     if (isa<ConstantExpr>(lSE->getKid(1)) &&
         isa<ConstantExpr>(lSE->getKid(2)) &&
@@ -553,10 +553,12 @@ void ExprPPrinter::printQuery(std::ostream &os,
 
   PC << "(query [";
   
-  // Ident at constraint list;
+  // Ident at constraint list; print the constraints in the order they
+  // were added.
   unsigned indent = PC.pos;
-  for (ConstraintManager::const_iterator it = constraints.begin(),
-         ie = constraints.end(); it != ie;) {
+  std::vector< ref<Expr> > ordered(constraints.begin(), constraints.end());
+  for (std::vector< ref<Expr> >::reverse_iterator it = ordered.rbegin(),
+         ie = ordered.rend(); it != ie;) {
     p.print(*it, PC);
     ++it;
     if (it != ie)
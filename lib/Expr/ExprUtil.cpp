@@ -14,6 +14,8 @@
 
 #include "klee/util/ExprVisitor.h"
 
+#include <algorithm>
+#include <cassert>
 #include <set>
 
 using namespace klee;
@@ -125,3 +127,41 @@ template void klee::findSymbolicObjects<A>(A, A, std::vector<const Array*> &);
 
 typedef std::set< ref<Expr> >::iterator B;
 template void klee::findSymbolicObjects<B>(B, B, std::vector<const Array*> &);
+
+void klee::getVectorLanes(const ref<Expr> &e, unsigned laneWidth,
+                          std::vector< ref<Expr> > &lanes) {
+  assert(e->getWidth() % laneWidth == 0 && "not a whole number of lanes");
+
+  // Flatten the concatenation tree, lowest bits first.
+  std::vector< ref<Expr> > pieces, stack(1, e);
+  while (!stack.empty()) {
+    ref<Expr> p = stack.back();
+    stack.pop_back();
+    if (ConcatExpr *ce = dyn_cast<ConcatExpr>(p)) {
+      stack.push_back(ce->getLeft());
+      stack.push_back(ce->getRight());
+    } else {
+      pieces.push_back(p);
+    }
+  }
+
+  // Regroup the pieces into lanes, splitting pieces that straddle a lane
+  // boundary.
+  ref<Expr> lane;
+  unsigned laneBits = 0;
+  for (std::vector< ref<Expr> >::iterator it = pieces.begin(), 
+         ie = pieces.end(); it != ie; ++it) {
+    ref<Expr> p = *it;
+    for (unsigned off = 0, w = p->getWidth(); off < w; ) {
+      unsigned take = std::min(w - off, laneWidth - laneBits);
+      ref<Expr> part = ExtractExpr::create(p, off, take);
+      lane = laneBits ? ConcatExpr::create(part, lane) : part;
+      laneBits += take;
+      off += take;
+      if (laneBits == laneWidth) {
+        lanes.push_back(lane);
+        laneBits = 0;
+      }
+    }
+  }
+}
@@ -26,9 +26,11 @@ UpdateNode::UpdateNode(const UpdateNode *_next,
   assert(_value->getWidth() == Expr::Int8 && 
          "Update value should be 8-bit wide.");
   computeHash();
+  concrete = isa<ConstantExpr>(index) && isa<ConstantExpr>(value);
   if (next) {
     ++next->refCount;
     size = 1 + next->size;
+    concrete = concrete && next->concrete;
   }
   else size = 1;
 }
@@ -84,7 +84,7 @@ namespace {
 
   cl::opt<bool>
   InstrumentSIMD("instrument-simd",
-                 cl::desc("Instrument every SIMD instruction with a call to klee_sse"),
+                 cl::desc("Count the executions of every SIMD instruction (in run.istats and run.simd)"),
                  cl::init(false));
 }
 
@@ -261,7 +261,7 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   if (opts.CheckDivZero) pm.add(new DivCheckPass());
   pm.add(createLowerAtomicPass());          // Lower llvm.atomic.*
   if (InstrumentSIMD)
-    pm.add(new SIMDInstrumentationPass());
+    pm.add(new SIMDInstrumentationPass(simdNames));
   pm.add(new LowerSSEPass());
   // FIXME: This false here is to work around a bug in
   // IntrinsicLowering which caches values which may eventually be
@@ -270,6 +270,13 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   pm.add(new IntrinsicCleanerPass(*targetData, false));
   pm.run(*module);
 
+  // The SIMD markers have served their purpose once SSE intrinsics are
+  // lowered. Left in, the optimizer would work around them and could move
+  // the instructions they mark.
+  std::vector< std::pair<WeakVH, unsigned> > simdStarts;
+  if (InstrumentSIMD)
+    SIMDInstrumentationPass::stripMarkers(*module, simdStarts);
+
   if (opts.Optimize)
     Optimize(module);
 
@@ -324,6 +331,14 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   pm3.add(new PhiCleanerPass());
   pm3.run(*module);
 
+  // The module is in its final form. Marked instructions that were
+  // optimized away are no longer counted.
+  for (unsigned i = 0; i < simdStarts.size(); ++i) {
+    Value *v = simdStarts[i].first;
+    if (Instruction *inst = dyn_cast_or_null<Instruction>(v))
+      simdInstructions.insert(std::make_pair(inst, simdStarts[i].second));
+  }
+
   // For cleanliness see if we can discard any of the functions we
   // forced to import.
   Function *f;
@@ -554,6 +569,16 @@ KFunction::KFunction(llvm::Function *_function,
 
       ki->inst = it;      
       ki->dest = registerMap[it];
+      ki->width = it->getType()->isSized() ?
+        km->targetData->getTypeSizeInBits(it->getType()) : 0;
+      ki->concreteHandler = 0;
+      ki->operandWidth = 0;
+      ki->constantMask = 0;
+
+      std::map<Instruction*, unsigned>::iterator simd = 
+        km->simdInstructions.find(it);
+      ki->simdIndex = 
+        simd == km->simdInstructions.end() ? -1 : (int) simd->second;
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         CallSite cs(it);
@@ -29,6 +29,7 @@
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 #include <sstream>
+#include <vector>
 
 using namespace llvm;
 
@@ -128,6 +129,498 @@ static Value *CreateAbsDiff(IRBuilder<> &builder, bool isSigned, const IntegerTy
 #define GET_ARG_OPERAND(INST, NUM) (INST)->getArgOperand(NUM)
 #endif
 
+namespace {
+  /// How the lanes of an intrinsic's operands combine into its result.
+  enum SSEShape {
+    SSE_Lanewise,   ///< res[i] = op(a[i], b[i])
+    SSE_Unary,      ///< res[i] = op(a[i])
+    SSE_Horizontal, ///< op over adjacent lane pairs of a, then of b
+    SSE_AddSub,     ///< even lanes subtract, odd lanes add
+    SSE_MulAdd,     ///< widened products of adjacent lane pairs, summed
+    SSE_MulEven,    ///< widened product of the even lanes
+    SSE_ShiftImm,   ///< every lane shifted by a scalar count
+    SSE_Shift,      ///< every lane shifted by the low quadword of b
+    SSE_Shuffle,    ///< bytes of a selected by the bytes of b
+    SSE_Blend,      ///< lanes of b selected by an immediate mask
+    SSE_BlendV,     ///< lanes of b selected by the sign bits of a third vector
+    SSE_Extend,     ///< low lanes of a extended to the result lanes
+    SSE_Pack,       ///< lanes of a then b narrowed to the result lanes
+    SSE_MoveMask,   ///< sign bits of a gathered into an integer
+    SSE_Test        ///< zero tests of a & b and ~a & b
+  };
+
+  enum SSEOp {
+    SSE_None,
+    SSE_Add, SSE_Sub, SSE_Min, SSE_Max,
+    SSE_MulHi, SSE_MulHiRound, SSE_Avg,
+    SSE_CmpEq, SSE_CmpGt,
+    SSE_Abs, SSE_Sign,
+    SSE_Shl, SSE_LShr, SSE_AShr,
+    SSE_TestZ, SSE_TestC, SSE_TestNZC
+  };
+
+  enum SSEFlags {
+    SSE_Signed = 1,        ///< lanes are signed integers
+    SSE_Saturate = 2,      ///< clamp results to the lane range
+    SSE_Float = 4,         ///< lanes are floating point
+    SSE_LowLane = 8,       ///< only lane 0 is computed, the rest come from a
+    SSE_UnsignedFirst = 16 ///< the lanes of a are unsigned even if b's are not
+  };
+
+  struct SSEIntrinsic {
+    Intrinsic::ID id;
+    SSEShape shape;
+    SSEOp op;
+    unsigned flags;
+  };
+}
+
+/// Intrinsics that are lowered by table. The ones with more irregular
+/// semantics are handled case by case in runOnBasicBlock.
+///
+/// Not lowered at all are the scalar and double compares (sse_cmp_ss,
+/// sse2_cmp_pd, sse2_cmp_sd), the comi/ucomi families, the reciprocal and
+/// square root estimates, and the conversions other than cvtdq2ps,
+/// cvtps2dq and cvtsd2si (e.g. cvtss2si, cvttss2si, cvttsd2si, cvttps2dq,
+/// cvtpd2dq, cvtps2pd, cvtpd2ps, cvtsd2ss, cvtss2sd).
+static const SSEIntrinsic sseIntrinsics[] = {
+  // SSE
+  { Intrinsic::x86_sse_min_ss,        SSE_Lanewise,   SSE_Min,   SSE_Float | SSE_LowLane },
+  { Intrinsic::x86_sse_max_ss,        SSE_Lanewise,   SSE_Max,   SSE_Float | SSE_LowLane },
+  { Intrinsic::x86_sse_movmsk_ps,     SSE_MoveMask,   SSE_None,  0 },
+
+  // SSE2
+  { Intrinsic::x86_sse2_min_sd,       SSE_Lanewise,   SSE_Min,   SSE_Float | SSE_LowLane },
+  { Intrinsic::x86_sse2_max_sd,       SSE_Lanewise,   SSE_Max,   SSE_Float | SSE_LowLane },
+  { Intrinsic::x86_sse2_min_pd,       SSE_Lanewise,   SSE_Min,   SSE_Float },
+  { Intrinsic::x86_sse2_max_pd,       SSE_Lanewise,   SSE_Max,   SSE_Float },
+  { Intrinsic::x86_sse2_padds_b,      SSE_Lanewise,   SSE_Add,   SSE_Signed | SSE_Saturate },
+  { Intrinsic::x86_sse2_psubs_b,      SSE_Lanewise,   SSE_Sub,   SSE_Signed | SSE_Saturate },
+  { Intrinsic::x86_sse2_psubs_w,      SSE_Lanewise,   SSE_Sub,   SSE_Signed | SSE_Saturate },
+  { Intrinsic::x86_sse2_pmulhu_w,     SSE_Lanewise,   SSE_MulHi, 0 },
+  { Intrinsic::x86_sse2_pavg_b,       SSE_Lanewise,   SSE_Avg,   0 },
+  { Intrinsic::x86_sse2_pavg_w,       SSE_Lanewise,   SSE_Avg,   0 },
+  { Intrinsic::x86_sse2_pcmpeq_b,     SSE_Lanewise,   SSE_CmpEq, 0 },
+  { Intrinsic::x86_sse2_pcmpeq_w,     SSE_Lanewise,   SSE_CmpEq, 0 },
+  { Intrinsic::x86_sse2_pcmpeq_d,     SSE_Lanewise,   SSE_CmpEq, 0 },
+  { Intrinsic::x86_sse2_pcmpgt_d,     SSE_Lanewise,   SSE_CmpGt, SSE_Signed },
+  { Intrinsic::x86_sse2_pmulu_dq,     SSE_MulEven,    SSE_None,  0 },
+  { Intrinsic::x86_sse2_pslli_w,      SSE_ShiftImm,   SSE_Shl,   0 },
+  { Intrinsic::x86_sse2_pslli_d,      SSE_ShiftImm,   SSE_Shl,   0 },
+  { Intrinsic::x86_sse2_pslli_q,      SSE_ShiftImm,   SSE_Shl,   0 },
+  { Intrinsic::x86_sse2_psrli_w,      SSE_ShiftImm,   SSE_LShr,  0 },
+  { Intrinsic::x86_sse2_psrli_d,      SSE_ShiftImm,   SSE_LShr,  0 },
+  { Intrinsic::x86_sse2_psrli_q,      SSE_ShiftImm,   SSE_LShr,  0 },
+  { Intrinsic::x86_sse2_psrai_w,      SSE_ShiftImm,   SSE_AShr,  0 },
+  { Intrinsic::x86_sse2_psrai_d,      SSE_ShiftImm,   SSE_AShr,  0 },
+  { Intrinsic::x86_sse2_psll_w,       SSE_Shift,      SSE_Shl,   0 },
+  { Intrinsic::x86_sse2_psll_d,       SSE_Shift,      SSE_Shl,   0 },
+  { Intrinsic::x86_sse2_psll_q,       SSE_Shift,      SSE_Shl,   0 },
+  { Intrinsic::x86_sse2_psrl_w,       SSE_Shift,      SSE_LShr,  0 },
+  { Intrinsic::x86_sse2_psrl_d,       SSE_Shift,      SSE_LShr,  0 },
+  { Intrinsic::x86_sse2_psrl_q,       SSE_Shift,      SSE_LShr,  0 },
+  { Intrinsic::x86_sse2_psra_w,       SSE_Shift,      SSE_AShr,  0 },
+  { Intrinsic::x86_sse2_psra_d,       SSE_Shift,      SSE_AShr,  0 },
+  { Intrinsic::x86_sse2_pmovmskb_128, SSE_MoveMask,   SSE_None,  0 },
+  { Intrinsic::x86_sse2_movmsk_pd,    SSE_MoveMask,   SSE_None,  0 },
+
+  // SSE3
+  { Intrinsic::x86_sse3_addsub_ps,    SSE_AddSub,     SSE_None,  SSE_Float },
+  { Intrinsic::x86_sse3_addsub_pd,    SSE_AddSub,     SSE_None,  SSE_Float },
+  { Intrinsic::x86_sse3_hadd_ps,      SSE_Horizontal, SSE_Add,   SSE_Float },
+  { Intrinsic::x86_sse3_hadd_pd,      SSE_Horizontal, SSE_Add,   SSE_Float },
+  { Intrinsic::x86_sse3_hsub_ps,      SSE_Horizontal, SSE_Sub,   SSE_Float },
+  { Intrinsic::x86_sse3_hsub_pd,      SSE_Horizontal, SSE_Sub,   SSE_Float },
+
+  // SSSE3
+  { Intrinsic::x86_ssse3_phadd_w_128,    SSE_Horizontal, SSE_Add, 0 },
+  { Intrinsic::x86_ssse3_phadd_d_128,    SSE_Horizontal, SSE_Add, 0 },
+  { Intrinsic::x86_ssse3_phadd_sw_128,   SSE_Horizontal, SSE_Add, SSE_Signed | SSE_Saturate },
+  { Intrinsic::x86_ssse3_phsub_w_128,    SSE_Horizontal, SSE_Sub, 0 },
+  { Intrinsic::x86_ssse3_phsub_d_128,    SSE_Horizontal, SSE_Sub, 0 },
+  { Intrinsic::x86_ssse3_phsub_sw_128,   SSE_Horizontal, SSE_Sub, SSE_Signed | SSE_Saturate },
+  { Intrinsic::x86_ssse3_pmadd_ub_sw_128, SSE_MulAdd,    SSE_None, SSE_Signed | SSE_Saturate | SSE_UnsignedFirst },
+  { Intrinsic::x86_ssse3_pmul_hr_sw_128, SSE_Lanewise,   SSE_MulHiRound, SSE_Signed },
+  { Intrinsic::x86_ssse3_pshuf_b_128,    SSE_Shuffle,    SSE_None, 0 },
+  { Intrinsic::x86_ssse3_psign_b_128,    SSE_Lanewise,   SSE_Sign, SSE_Signed },
+  { Intrinsic::x86_ssse3_psign_w_128,    SSE_Lanewise,   SSE_Sign, SSE_Signed },
+  { Intrinsic::x86_ssse3_psign_d_128,    SSE_Lanewise,   SSE_Sign, SSE_Signed },
+  { Intrinsic::x86_ssse3_pabs_b_128,     SSE_Unary,      SSE_Abs,  SSE_Signed },
+  { Intrinsic::x86_ssse3_pabs_w_128,     SSE_Unary,      SSE_Abs,  SSE_Signed },
+  { Intrinsic::x86_ssse3_pabs_d_128,     SSE_Unary,      SSE_Abs,  SSE_Signed },
+
+  // SSE4.1
+  { Intrinsic::x86_sse41_pminsb,      SSE_Lanewise,   SSE_Min,   SSE_Signed },
+  { Intrinsic::x86_sse41_pminsd,      SSE_Lanewise,   SSE_Min,   SSE_Signed },
+  { Intrinsic::x86_sse41_pminuw,      SSE_Lanewise,   SSE_Min,   0 },
+  { Intrinsic::x86_sse41_pminud,      SSE_Lanewise,   SSE_Min,   0 },
+  { Intrinsic::x86_sse41_pmaxsb,      SSE_Lanewise,   SSE_Max,   SSE_Signed },
+  { Intrinsic::x86_sse41_pmaxsd,      SSE_Lanewise,   SSE_Max,   SSE_Signed },
+  { Intrinsic::x86_sse41_pmaxuw,      SSE_Lanewise,   SSE_Max,   0 },
+  { Intrinsic::x86_sse41_pmaxud,      SSE_Lanewise,   SSE_Max,   0 },
+  { Intrinsic::x86_sse41_pcmpeqq,     SSE_Lanewise,   SSE_CmpEq, 0 },
+  { Intrinsic::x86_sse41_pmuldq,      SSE_MulEven,    SSE_None,  SSE_Signed },
+  { Intrinsic::x86_sse41_packusdw,    SSE_Pack,       SSE_None,  SSE_Saturate },
+  { Intrinsic::x86_sse41_blendps,     SSE_Blend,      SSE_None,  0 },
+  { Intrinsic::x86_sse41_blendpd,     SSE_Blend,      SSE_None,  0 },
+  { Intrinsic::x86_sse41_pblendw,     SSE_Blend,      SSE_None,  0 },
+  { Intrinsic::x86_sse41_blendvps,    SSE_BlendV,     SSE_None,  0 },
+  { Intrinsic::x86_sse41_blendvpd,    SSE_BlendV,     SSE_None,  0 },
+  { Intrinsic::x86_sse41_pblendvb,    SSE_BlendV,     SSE_None,  0 },
+  { Intrinsic::x86_sse41_pmovsxbw,    SSE_Extend,     SSE_None,  SSE_Signed },
+  { Intrinsic::x86_sse41_pmovsxbd,    SSE_Extend,     SSE_None,  SSE_Signed },
+  { Intrinsic::x86_sse41_pmovsxbq,    SSE_Extend,     SSE_None,  SSE_Signed },
+  { Intrinsic::x86_sse41_pmovsxwd,    SSE_Extend,     SSE_None,  SSE_Signed },
+  { Intrinsic::x86_sse41_pmovsxwq,    SSE_Extend,     SSE_None,  SSE_Signed },
+  { Intrinsic::x86_sse41_pmovsxdq,    SSE_Extend,     SSE_None,  SSE_Signed },
+  { Intrinsic::x86_sse41_pmovzxbw,    SSE_Extend,     SSE_None,  0 },
+  { Intrinsic::x86_sse41_pmovzxbd,    SSE_Extend,     SSE_None,  0 },
+  { Intrinsic::x86_sse41_pmovzxbq,    SSE_Extend,     SSE_None,  0 },
+  { Intrinsic::x86_sse41_pmovzxwd,    SSE_Extend,     SSE_None,  0 },
+  { Intrinsic::x86_sse41_pmovzxwq,    SSE_Extend,     SSE_None,  0 },
+  { Intrinsic::x86_sse41_pmovzxdq,    SSE_Extend,     SSE_None,  0 },
+  { Intrinsic::x86_sse41_ptestz,      SSE_Test,       SSE_TestZ,   0 },
+  { Intrinsic::x86_sse41_ptestc,      SSE_Test,       SSE_TestC,   0 },
+  { Intrinsic::x86_sse41_ptestnzc,    SSE_Test,       SSE_TestNZC, 0 }
+};
+
+static const SSEIntrinsic *LookupSSEIntrinsic(Intrinsic::ID id) {
+  for (unsigned i = 0; i < sizeof(sseIntrinsics)/sizeof(sseIntrinsics[0]); i++)
+    if (sseIntrinsics[i].id == id)
+      return &sseIntrinsics[i];
+  return 0;
+}
+
+bool LowerSSEPass::canLower(unsigned IID) {
+  switch (IID) {
+#define SSE_LOWERED(ID) case Intrinsic::ID:
+#include "klee/Internal/Module/SSEIntrinsics.def"
+    return true;
+  default:
+    return LookupSSEIntrinsic((Intrinsic::ID) IID) != 0;
+  }
+}
+
+/// Computes \arg op on \arg l and \arg r at twice the lane width and
+/// saturates the result back to the lane type.
+static Value *CreateWidenedSaturatedOp(IRBuilder<> &builder, Instruction::BinaryOps op,
+                                       bool isSigned, Value *l, Value *r) {
+  const IntegerType *t = cast<IntegerType>(l->getType());
+  const IntegerType *wt = IntegerType::get(getGlobalContext(), t->getBitWidth()*2);
+  Value *res = builder.CreateBinOp(op, builder.CreateIntCast(l, wt, isSigned),
+                                       builder.CreateIntCast(r, wt, isSigned));
+  if (!isSigned) // An unsigned difference below zero wraps to a large value.
+    res = builder.CreateSelect(CreateIsNegative(builder, res), ConstantInt::get(wt, 0), res);
+  return CreateSaturatedValue(builder, isSigned, t, res);
+}
+
+static Value *CreateLaneOp(IRBuilder<> &builder, const SSEIntrinsic &info, Value *l, Value *r) {
+  bool isSigned = info.flags & SSE_Signed;
+  bool isFloat = info.flags & SSE_Float;
+
+  switch (info.op) {
+  case SSE_Add:
+    if (isFloat)
+      return builder.CreateFAdd(l, r);
+    if (info.flags & SSE_Saturate)
+      return CreateWidenedSaturatedOp(builder, Instruction::Add, isSigned, l, r);
+    return builder.CreateAdd(l, r);
+
+  case SSE_Sub:
+    if (isFloat)
+      return builder.CreateFSub(l, r);
+    if (info.flags & SSE_Saturate)
+      return CreateWidenedSaturatedOp(builder, Instruction::Sub, isSigned, l, r);
+    return builder.CreateSub(l, r);
+
+  case SSE_Min:
+  case SSE_Max:
+    return CreateMinMax(builder, info.op == SSE_Max, isFloat, isSigned, l, r);
+
+  case SSE_MulHi: {
+    const IntegerType *t = cast<IntegerType>(l->getType());
+    const IntegerType *wt = IntegerType::get(getGlobalContext(), t->getBitWidth()*2);
+    Value *mul = builder.CreateMul(builder.CreateIntCast(l, wt, isSigned),
+                                   builder.CreateIntCast(r, wt, isSigned));
+    return builder.CreateTrunc(builder.CreateLShr(mul, t->getBitWidth()), t);
+  }
+
+  case SSE_MulHiRound: {
+    // Bits [16:1] of the 32 bit product after adding 1 << 14.
+    const IntegerType *t = cast<IntegerType>(l->getType());
+    const IntegerType *i32 = Type::getInt32Ty(getGlobalContext());
+    Value *mul = builder.CreateMul(builder.CreateSExt(l, i32), builder.CreateSExt(r, i32));
+    Value *rnd = builder.CreateAdd(builder.CreateAShr(mul, 14), ConstantInt::get(i32, 1));
+    return builder.CreateTrunc(builder.CreateAShr(rnd, 1), t);
+  }
+
+  case SSE_Avg: {
+    // Rounds half up.
+    const IntegerType *t = cast<IntegerType>(l->getType());
+    const IntegerType *wt = IntegerType::get(getGlobalContext(), t->getBitWidth()*2);
+    Value *sum = builder.CreateAdd(builder.CreateZExt(l, wt), builder.CreateZExt(r, wt));
+    sum = builder.CreateAdd(sum, ConstantInt::get(wt, 1));
+    return builder.CreateTrunc(builder.CreateLShr(sum, 1), t);
+  }
+
+  case SSE_CmpEq:
+    return CreateSignExtendedICmp(builder, ICmpInst::ICMP_EQ, l, r);
+
+  case SSE_CmpGt:
+    return CreateSignExtendedICmp(builder, ICmpInst::ICMP_SGT, l, r);
+
+  case SSE_Abs:
+    return builder.CreateSelect(CreateIsNegative(builder, l), builder.CreateNeg(l), l);
+
+  case SSE_Sign: {
+    Constant *zero = ConstantInt::get(l->getType(), 0);
+    return builder.CreateSelect(CreateIsNegative(builder, r), builder.CreateNeg(l),
+           builder.CreateSelect(builder.CreateICmpEQ(r, zero), zero, l));
+  }
+
+  default:
+    assert(0 && "Unexpected lane operation");
+    return 0;
+  }
+}
+
+/// Shifts \arg l by the 64 bit \arg count, which may be as large as the
+/// lane or larger: logical shifts then produce zero and arithmetic shifts
+/// fill the lane with its sign bit.
+static Value *CreateLaneShift(IRBuilder<> &builder, SSEOp op, Value *l, Value *count) {
+  const IntegerType *t = cast<IntegerType>(l->getType());
+  const IntegerType *i64 = Type::getInt64Ty(getGlobalContext());
+  unsigned width = t->getBitWidth();
+  Value *tooBig = builder.CreateICmpUGE(count, ConstantInt::get(i64, width));
+
+  if (op == SSE_AShr) {
+    Value *amt = builder.CreateSelect(tooBig, ConstantInt::get(i64, width-1), count);
+    return builder.CreateAShr(l, builder.CreateTrunc(amt, t));
+  }
+
+  Value *amt = builder.CreateTrunc(builder.CreateSelect(tooBig, ConstantInt::get(i64, 0), count), t);
+  Value *res = op == SSE_Shl ? builder.CreateShl(l, amt) : builder.CreateLShr(l, amt);
+  return builder.CreateSelect(tooBig, ConstantInt::get(t, 0), res);
+}
+
+static Value *CreateLaneBits(IRBuilder<> &builder, Value *v) {
+  unsigned bits = v->getType()->getPrimitiveSizeInBits();
+  return builder.CreateBitCast(v, IntegerType::get(getGlobalContext(), bits));
+}
+
+/// Builds the lowering of \arg ii described by \arg info and returns the
+/// value that replaces it.
+static Value *LowerSSEIntrinsic(IRBuilder<> &builder, IntrinsicInst *ii, const SSEIntrinsic &info) {
+  const IntegerType *i32 = Type::getInt32Ty(getGlobalContext());
+  const IntegerType *i64 = Type::getInt64Ty(getGlobalContext());
+  const IntegerType *i128 = IntegerType::get(getGlobalContext(), 128);
+
+  Value *src1 = GET_ARG_OPERAND(ii, 0);
+  const VectorType *vt = dyn_cast<VectorType>(src1->getType());
+  const VectorType *rt = dyn_cast<VectorType>(ii->getType());
+
+  switch (info.shape) {
+  case SSE_Lanewise:
+  case SSE_Unary: {
+    Value *src2 = info.shape == SSE_Unary ? 0 : GET_ARG_OPERAND(ii, 1);
+    unsigned elCount = info.flags & SSE_LowLane ? 1 : rt->getNumElements();
+    Value *res = info.flags & SSE_LowLane ? src1 : UndefValue::get(rt);
+    for (unsigned i = 0; i < elCount; i++) {
+      Constant *ic = ConstantInt::get(i32, i);
+      Value *r = src2 ? builder.CreateExtractElement(src2, ic) : 0;
+      res = builder.CreateInsertElement(res,
+                                        CreateLaneOp(builder, info,
+                                                     builder.CreateExtractElement(src1, ic), r),
+                                        ic);
+    }
+    return res;
+  }
+
+  case SSE_Horizontal: {
+    Value *src2 = GET_ARG_OPERAND(ii, 1);
+    unsigned half = rt->getNumElements() / 2;
+    Value *res = UndefValue::get(rt);
+    for (unsigned i = 0; i < rt->getNumElements(); i++) {
+      Value *src = i < half ? src1 : src2;
+      unsigned j = (i % half) * 2;
+      Value *l = builder.CreateExtractElement(src, ConstantInt::get(i32, j));
+      Value *r = builder.CreateExtractElement(src, ConstantInt::get(i32, j+1));
+      res = builder.CreateInsertElement(res, CreateLaneOp(builder, info, l, r),
+                                        ConstantInt::get(i32, i));
+    }
+    return res;
+  }
+
+  case SSE_AddSub: {
+    Value *src2 = GET_ARG_OPERAND(ii, 1);
+    Value *res = UndefValue::get(rt);
+    for (unsigned i = 0; i < rt->getNumElements(); i++) {
+      Constant *ic = ConstantInt::get(i32, i);
+      Value *l = builder.CreateExtractElement(src1, ic);
+      Value *r = builder.CreateExtractElement(src2, ic);
+      res = builder.CreateInsertElement(res,
+                                        i % 2 ? builder.CreateFAdd(l, r) : builder.CreateFSub(l, r),
+                                        ic);
+    }
+    return res;
+  }
+
+  case SSE_MulAdd: {
+    Value *src2 = GET_ARG_OPERAND(ii, 1);
+    const IntegerType *et = cast<IntegerType>(rt->getElementType());
+    const IntegerType *wt = IntegerType::get(getGlobalContext(), et->getBitWidth()*2);
+    bool isSigned = info.flags & SSE_Signed;
+    bool firstSigned = isSigned && !(info.flags & SSE_UnsignedFirst);
+    Value *res = UndefValue::get(rt);
+    for (unsigned i = 0; i < rt->getNumElements(); i++) {
+      Value *sum = 0;
+      for (unsigned j = i*2; j < i*2+2; j++) {
+        Constant *jc = ConstantInt::get(i32, j);
+        Value *x = builder.CreateIntCast(builder.CreateExtractElement(src1, jc), wt, firstSigned);
+        Value *y = builder.CreateIntCast(builder.CreateExtractElement(src2, jc), wt, isSigned);
+        Value *mul = builder.CreateMul(x, y);
+        sum = sum ? builder.CreateAdd(sum, mul) : mul;
+      }
+      Value *el = info.flags & SSE_Saturate ? CreateSaturatedValue(builder, isSigned, et, sum)
+                                            : builder.CreateTrunc(sum, et);
+      res = builder.CreateInsertElement(res, el, ConstantInt::get(i32, i));
+    }
+    return res;
+  }
+
+  case SSE_MulEven: {
+    Value *src2 = GET_ARG_OPERAND(ii, 1);
+    bool isSigned = info.flags & SSE_Signed;
+    Value *res = UndefValue::get(rt);
+    for (unsigned i = 0; i < rt->getNumElements(); i++) {
+      Constant *i2c = ConstantInt::get(i32, i*2);
+      Value *x = builder.CreateIntCast(builder.CreateExtractElement(src1, i2c),
+                                       rt->getElementType(), isSigned);
+      Value *y = builder.CreateIntCast(builder.CreateExtractElement(src2, i2c),
+                                       rt->getElementType(), isSigned);
+      res = builder.CreateInsertElement(res, builder.CreateMul(x, y), ConstantInt::get(i32, i));
+    }
+    return res;
+  }
+
+  case SSE_ShiftImm:
+  case SSE_Shift: {
+    Value *count = GET_ARG_OPERAND(ii, 1);
+    if (info.shape == SSE_Shift)
+      count = builder.CreateTrunc(builder.CreateBitCast(count, i128), i64);
+    else
+      count = builder.CreateZExt(count, i64);
+    Value *res = UndefValue::get(rt);
+    for (unsigned i = 0; i < rt->getNumElements(); i++) {
+      Constant *ic = ConstantInt::get(i32, i);
+      res = builder.CreateInsertElement(res,
+                                        CreateLaneShift(builder, info.op,
+                                                        builder.CreateExtractElement(src1, ic), count),
+                                        ic);
+    }
+    return res;
+  }
+
+  case SSE_Shuffle: {
+    // A set top bit in the selector zeroes the byte, otherwise its low
+    // four bits index into the source.
+    Value *src2 = GET_ARG_OPERAND(ii, 1);
+    const IntegerType *i8 = Type::getInt8Ty(getGlobalContext());
+    Value *res = UndefValue::get(rt);
+    for (unsigned i = 0; i < rt->getNumElements(); i++) {
+      Constant *ic = ConstantInt::get(i32, i);
+      Value *sel = builder.CreateExtractElement(src2, ic);
+      Value *idx = builder.CreateZExt(builder.CreateAnd(sel, ConstantInt::get(i8, rt->getNumElements()-1)), i32);
+      Value *el = builder.CreateSelect(CreateIsNegative(builder, sel), ConstantInt::get(i8, 0),
+                                       builder.CreateExtractElement(src1, idx));
+      res = builder.CreateInsertElement(res, el, ic);
+    }
+    return res;
+  }
+
+  case SSE_Blend: {
+    Value *src2 = GET_ARG_OPERAND(ii, 1);
+    uint64_t mask = cast<ConstantInt>(GET_ARG_OPERAND(ii, 2))->getZExtValue();
+    unsigned elCount = rt->getNumElements();
+    std::vector<Constant*> indices;
+    for (unsigned i = 0; i < elCount; i++)
+      indices.push_back(ConstantInt::get(i32, (mask >> i) & 1 ? i + elCount : i));
+    return builder.CreateShuffleVector(src1, src2, ConstantVector::get(indices));
+  }
+
+  case SSE_BlendV: {
+    Value *src2 = GET_ARG_OPERAND(ii, 1);
+    Value *sel = GET_ARG_OPERAND(ii, 2);
+    Value *res = UndefValue::get(rt);
+    for (unsigned i = 0; i < rt->getNumElements(); i++) {
+      Constant *ic = ConstantInt::get(i32, i);
+      Value *selBits = CreateLaneBits(builder, builder.CreateExtractElement(sel, ic));
+      res = builder.CreateInsertElement(res,
+                                        builder.CreateSelect(CreateIsNegative(builder, selBits),
+                                                             builder.CreateExtractElement(src2, ic),
+                                                             builder.CreateExtractElement(src1, ic)),
+                                        ic);
+    }
+    return res;
+  }
+
+  case SSE_Extend: {
+    Value *res = UndefValue::get(rt);
+    for (unsigned i = 0; i < rt->getNumElements(); i++) {
+      Constant *ic = ConstantInt::get(i32, i);
+      res = builder.CreateInsertElement(res,
+                                        builder.CreateIntCast(builder.CreateExtractElement(src1, ic),
+                                                              rt->getElementType(),
+                                                              info.flags & SSE_Signed),
+                                        ic);
+    }
+    return res;
+  }
+
+  case SSE_Pack: {
+    // Signed lanes saturated to the unsigned range of the result lanes.
+    Value *src2 = GET_ARG_OPERAND(ii, 1);
+    const IntegerType *et = cast<IntegerType>(rt->getElementType());
+    unsigned srcElCount = vt->getNumElements();
+    Value *res = UndefValue::get(rt);
+    for (unsigned i = 0; i < rt->getNumElements(); i++) {
+      Value *src = i < srcElCount ? src1 : src2;
+      Value *el = builder.CreateExtractElement(src, ConstantInt::get(i32, i % srcElCount));
+      el = builder.CreateSelect(CreateIsNegative(builder, el), ConstantInt::get(el->getType(), 0), el);
+      res = builder.CreateInsertElement(res, CreateSaturatedValue(builder, false, et, el),
+                                        ConstantInt::get(i32, i));
+    }
+    return res;
+  }
+
+  case SSE_MoveMask: {
+    Value *res = ConstantInt::get(ii->getType(), 0);
+    for (unsigned i = 0; i < vt->getNumElements(); i++) {
+      Value *bits = CreateLaneBits(builder, builder.CreateExtractElement(src1, ConstantInt::get(i32, i)));
+      unsigned width = cast<IntegerType>(bits->getType())->getBitWidth();
+      Value *bit = builder.CreateZExt(builder.CreateLShr(bits, width-1), ii->getType());
+      res = builder.CreateOr(res, builder.CreateShl(bit, i));
+    }
+    return res;
+  }
+
+  case SSE_Test: {
+    Value *a = builder.CreateBitCast(src1, i128);
+    Value *b = builder.CreateBitCast(GET_ARG_OPERAND(ii, 1), i128);
+    Constant *zero = ConstantInt::get(i128, 0);
+    Value *z = builder.CreateICmpEQ(builder.CreateAnd(a, b), zero);
+    Value *c = builder.CreateICmpEQ(builder.CreateAnd(builder.CreateNot(a), b), zero);
+    Value *res = info.op == SSE_TestZ ? z :
+                 info.op == SSE_TestC ? c :
+                 builder.CreateAnd(builder.CreateNot(z), builder.CreateNot(c));
+    return builder.CreateZExt(res, ii->getType());
+  }
+  }
+
+  assert(0 && "Unexpected intrinsic shape");
+  return 0;
+}
+
 bool LowerSSEPass::runOnBasicBlock(BasicBlock &b) { 
   bool dirty = false;
   
@@ -135,9 +628,20 @@ bool LowerSSEPass::runOnBasicBlock(BasicBlock &b) {
     IntrinsicInst *ii = dyn_cast<IntrinsicInst>(&*i);
     // increment now since LowerIntrinsic deletion makes iterator invalid.
     ++i;  
-    if(ii) {
+    if(ii && canLower(ii->getIntrinsicID())) {
       IRBuilder<> builder(ii->getParent(), ii);
 
+      // The SIMDInstrumentationPass marker in front of the intrinsic, which
+      // must go if the lowering folds away to nothing, or it would mark the
+      // next instruction.
+      Instruction *marker = 0;
+      if (BasicBlock::iterator(ii) != b.begin()) {
+        BasicBlock::iterator prev = ii;
+        --prev;
+        if (SIMDInstrumentationPass::isMarker(prev))
+          marker = prev;
+      }
+
       switch (ii->getIntrinsicID()) {
       case Intrinsic::x86_sse_loadu_ps:
       case Intrinsic::x86_sse2_loadu_dq: {
@@ -471,51 +975,6 @@ bool LowerSSEPass::runOnBasicBlock(BasicBlock &b) {
         break;
       }
 
-      case Intrinsic::x86_sse2_psrai_d:
-      case Intrinsic::x86_sse2_psrai_w:
-      case Intrinsic::x86_sse2_psrli_w:
-      case Intrinsic::x86_sse2_pslli_w: {
-        Value *src = GET_ARG_OPERAND(ii, 0);
-        Value *count = GET_ARG_OPERAND(ii, 1);
-
-        const VectorType *vt = cast<VectorType>(src->getType());
-        unsigned elCount = vt->getNumElements();
-
-        assert(ii->getType() == vt);
-
-        Instruction::BinaryOps opc;
-        switch (ii->getIntrinsicID()) {
-          case Intrinsic::x86_sse2_psrai_d:
-          case Intrinsic::x86_sse2_psrai_w:
-            opc = Instruction::AShr; break;
-          case Intrinsic::x86_sse2_psrli_w:
-            opc = Instruction::LShr; break;
-          case Intrinsic::x86_sse2_pslli_w:
-            opc = Instruction::Shl; break;
-          default:
-            assert(0 && "Unexpected intrinsic");
-        }
-
-        count = builder.CreateIntCast(count, vt->getElementType(), false);
-
-        const IntegerType *i32 = Type::getInt32Ty(getGlobalContext());
-
-        Value *res = UndefValue::get(vt);
-
-        for (unsigned i = 0; i < elCount; i++) {
-          Constant *ic = ConstantInt::get(i32, i);
-          res = builder.CreateInsertElement(res,
-                                            builder.CreateBinOp(opc, builder.CreateExtractElement(src, ic), count),
-                                            ic);
-        }
-
-        ii->replaceAllUsesWith(res);
-
-        ii->removeFromParent();
-        delete ii;
-        break;
-      }
-
       case Intrinsic::x86_sse2_pmulh_w: {
         Value *src1 = GET_ARG_OPERAND(ii, 0);
         Value *src2 = GET_ARG_OPERAND(ii, 1);
@@ -684,9 +1143,23 @@ bool LowerSSEPass::runOnBasicBlock(BasicBlock &b) {
         break;
       }
 
-      default:
+      default: {
+        // Every SSE_LOWERED intrinsic has a case above.
+        const SSEIntrinsic *info = LookupSSEIntrinsic(ii->getIntrinsicID());
+        assert(info && "SSE_LOWERED intrinsic without a lowering");
+        Value *res = LowerSSEIntrinsic(builder, ii, *info);
+
+        ii->replaceAllUsesWith(res);
+
+        ii->removeFromParent();
+        delete ii;
+        dirty = true;
         break;
       }
+      }
+
+      if (marker && &*++BasicBlock::iterator(marker) == &*i)
+        marker->eraseFromParent();
     }
   }
 
@@ -15,6 +15,11 @@
 #include "llvm/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/CodeGen/IntrinsicLowering.h"
+#include "llvm/Support/ValueHandle.h"
+
+#include <map>
+#include <string>
+#include <vector>
 
 namespace llvm {
   class Function;
@@ -79,17 +84,38 @@ public:
     : llvm::ModulePass((intptr_t) &ID) {}
   
   virtual bool runOnModule(llvm::Module &M);
+
+  /// Returns true if calls to the intrinsic \arg IID are lowered by this
+  /// pass.
+  static bool canLower(unsigned IID);
 };
   
+/// SIMDInstrumentationPass - Mark the start of every SIMD instruction with a
+/// call carrying the index of its name in the given list, so that the
+/// instruction can be found again after SSE intrinsics have been lowered.
 class SIMDInstrumentationPass : public llvm::ModulePass {
   static char ID;
 
+  std::vector<std::string> &names;
+  std::map<std::string, unsigned> nameIndices;
+
+  unsigned getNameIndex(llvm::StringRef name);
   bool runOnBasicBlock(llvm::BasicBlock &b);
 public:
-  SIMDInstrumentationPass()
-    : llvm::ModulePass((intptr_t) &ID) {}
+  SIMDInstrumentationPass(std::vector<std::string> &_names)
+    : llvm::ModulePass((intptr_t) &ID), names(_names) {}
   
   virtual bool runOnModule(llvm::Module &M);
+
+  /// Whether \a i is a marker call inserted by this pass.
+  static bool isMarker(const llvm::Instruction *i);
+
+  /// Remove the marker calls from the module, recording the instruction
+  /// that followed each of them along with its name index. The handles
+  /// become null if later passes delete the instruction.
+  static void stripMarkers(llvm::Module &M,
+                           std::vector< std::pair<llvm::WeakVH, 
+                                                  unsigned> > &starts);
 };
   
   // performs two transformations which make interpretation
@@ -10,7 +10,6 @@
 #include "Passes.h"
 
 #include "klee/Config/config.h"
-#include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/SIMDRecognition.h"
 #include "llvm/Constants.h"
 #include "llvm/DerivedTypes.h"
@@ -29,7 +28,9 @@
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
-#include <sstream>
+#include <map>
+#include <string>
+#include <vector>
 
 using namespace llvm;
 
@@ -45,87 +46,81 @@ bool SIMDInstrumentationPass::runOnModule(Module &M) {
   return dirty;
 }
 
-static Constant *CreateStrConstPtr(Module *mod, StringRef str) {
-  std::string strName = "__strconst_" + str.str();
-  GlobalVariable *strVar = mod->getGlobalVariable(strName, true);
+/// Name of the function whose calls mark the start of a SIMD operation.
+/// The calls never reach the executor, they are removed again by
+/// stripMarkers() once SSE intrinsics have been lowered.
+static const char *MarkerName = "klee_simd_marker";
 
-  if (!strVar) {
-    Constant *strConst = ConstantArray::get(mod->getContext(), str);
+unsigned SIMDInstrumentationPass::getNameIndex(StringRef name) {
+  std::map<std::string, unsigned>::iterator it = nameIndices.find(name.str());
+  if (it != nameIndices.end())
+    return it->second;
 
-    strVar = new GlobalVariable(*mod, strConst->getType(), true,
-                                GlobalValue::InternalLinkage,
-                                strConst, strName);
-  }
-
-  Constant *zero32 = ConstantInt::getNullValue(Type::getInt32Ty(mod->getContext()));
-  Constant *indexes[] = { zero32, zero32 };
-
-  Constant *strVarStartPtr =
-    ConstantExpr::getGetElementPtr(strVar, indexes,
-				   sizeof(indexes)/sizeof(indexes[0]));
-
-  return strVarStartPtr;
-}
-
-/// Find instruction number by finding the instruction's place in
-/// the basic block.
-static unsigned InstructionNumber(Instruction *i) {
-  BasicBlock *bb = i->getParent();
-  unsigned instrNum = 0;
-  for (BasicBlock::iterator ii = bb->begin(), ie = bb->end(); ii != ie; ++ii, ++instrNum) {
-    if (&*ii == i)
-      return instrNum;
-  }
-  assert(0 && "Could not find instruction in basic block!");
-}
-
-static void CreateSSECallback(IRBuilder<> &builder, Instruction *i,
-                              const std::string &file, unsigned line) {
-  Module *mod = i->getParent()->getParent()->getParent();
-  Constant *fc = mod->getOrInsertFunction("klee_sse", 
-                                          builder.getVoidTy(), 
-                                          builder.getInt8PtrTy(),
-                                          builder.getInt8PtrTy(),
-                                          builder.getInt32Ty(),
-                                          builder.getInt8PtrTy(),
-                                          builder.getInt8PtrTy(),
-                                          NULL);
-
-  StringRef instrName = i->getName();
-  std::ostringstream ss;
-  ss << i->getParent()->getName().str() << " ";
-  if (instrName.empty())
-    ss << InstructionNumber(i);
-  else
-    ss << instrName.str();
-
-  Value *args[] = {
-    CreateStrConstPtr(mod, getIntrinsicOrInstructionName(i)),
-    CreateStrConstPtr(mod, file),
-    ConstantInt::get(builder.getInt32Ty(), line),
-    CreateStrConstPtr(mod, i->getParent()->getParent()->getName()),
-    CreateStrConstPtr(mod, ss.str())
-  };
-
-  builder.CreateCall(fc, args, args + sizeof(args)/sizeof(args[0]));
+  unsigned index = names.size();
+  names.push_back(name.str());
+  nameIndices.insert(std::make_pair(name.str(), index));
+  return index;
 }
 
 bool SIMDInstrumentationPass::runOnBasicBlock(BasicBlock &b) { 
   bool dirty = false;
+  Module *mod = b.getParent()->getParent();
   
-  std::string file = "unknown";
-  unsigned line = 0;
-    
   for (BasicBlock::iterator i = b.begin(), ie = b.end(); i != ie; ++i) {     
-    getInstructionDebugInfo(i, file, line);
+    // Nothing can be inserted between PHI nodes.
+    if (isa<PHINode>(i))
+      continue;
 
     if(isSIMDInstruction(i)) {
       IRBuilder<> builder(i->getParent(), i);
-      CreateSSECallback(builder, i, file, line);
+      Constant *fc = mod->getOrInsertFunction(MarkerName,
+                                              builder.getVoidTy(),
+                                              builder.getInt32Ty(),
+                                              NULL);
+      unsigned index = getNameIndex(getIntrinsicOrInstructionName(i));
+      builder.CreateCall(fc, ConstantInt::get(builder.getInt32Ty(), index));
       dirty = true;
     }
   }
 
   return dirty;
 }
+
+bool SIMDInstrumentationPass::isMarker(const Instruction *i) {
+  if (const CallInst *ci = dyn_cast<CallInst>(i))
+    if (const Function *f = ci->getCalledFunction())
+      return f->getName() == MarkerName;
+  return false;
+}
+
+void SIMDInstrumentationPass::stripMarkers(Module &M,
+                                           std::vector< std::pair<WeakVH, 
+                                                                  unsigned> > &starts) {
+  Function *marker = M.getFunction(MarkerName);
+  if (!marker)
+    return;
+
+  std::vector<CallInst*> markers;
+  for (Value::use_iterator it = marker->use_begin(), ie = marker->use_end();
+       it != ie; ++it)
+    markers.push_back(cast<CallInst>(*it));
+
+  for (std::vector<CallInst*>::iterator it = markers.begin(), 
+         ie = markers.end(); it != ie; ++it) {
+    // Lowering may have turned the operation into several instructions,
+    // the marker is still in front of the first of them. Of consecutive
+    // markers only the last one still has its operation, the others are
+    // skipped.
+    BasicBlock::iterator next = *it;
+    ++next;
+    if (!isMarker(next))
+      starts.push_back(std::make_pair(WeakVH(&*next), 
+                                      cast<ConstantInt>((*it)->getOperand(1))->getZExtValue()));
+  }
+
+  for (std::vector<CallInst*>::iterator it = markers.begin(), 
+         ie = markers.end(); it != ie; ++it)
+    (*it)->eraseFromParent();
+  marker->eraseFromParent();
+}
 }
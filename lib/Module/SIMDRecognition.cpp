@@ -7,6 +7,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "Passes.h"
+
 #include <klee/Internal/Module/SIMDRecognition.h>
 #include <llvm/Instruction.h>
 #include <llvm/Instructions.h>
@@ -51,6 +53,28 @@ bool klee::isSIMDInstruction(Instruction *i) {
   return false;
 }
 
+// Is this an SSE intrinsic that Executor::executeCall evaluates itself?
+static bool isExecutorIntrinsic(unsigned IID) {
+  switch (IID) {
+#define SSE_EXECUTED(ID) case Intrinsic::ID:
+#include "klee/Internal/Module/SSEIntrinsics.def"
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Is this an SSE intrinsic call that LowerSSEPass leaves in place and the
+// executor does not handle, and which therefore becomes an external call at
+// run time?
+bool klee::isUnsupportedSIMDIntrinsic(Instruction *i) {
+  IntrinsicInst *ii = dyn_cast<IntrinsicInst>(i);
+  if (!ii || !isSIMDInstruction(i))
+    return false;
+  unsigned IID = ii->getIntrinsicID();
+  return !klee::LowerSSEPass::canLower(IID) && !isExecutorIntrinsic(IID);
+}
+
 StringRef klee::getIntrinsicOrInstructionName(Instruction *i) {
   if (IntrinsicInst *ii = dyn_cast<IntrinsicInst>(i))
     return ii->getCalledFunction()->getName();
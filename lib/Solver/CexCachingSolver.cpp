@@ -14,6 +14,7 @@
 #include "klee/SolverImpl.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/BatchEvaluator.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
 #include "klee/Internal/ADT/MapOfSets.h"
@@ -134,11 +135,29 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
     }
 
     // Otherwise, iterate through the set of current assignments to see if one
-    // of them satisfies the query.
+    // of them satisfies the query. The key is evaluated under all of them in
+    // one batch; only the assignments the batch cannot decide are checked
+    // individually.
+    std::vector<const Assignment*> assignments(assignmentsTable.begin(),
+                                               assignmentsTable.end());
+    std::vector< ref<Expr> > constraints(key.begin(), key.end());
+    BatchEvaluator batch(constraints);
+    batch.evaluate(assignments);
+    unsigned i = 0;
     for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
-           ie = assignmentsTable.end(); it != ie; ++it) {
+           ie = assignmentsTable.end(); it != ie; ++it, ++i) {
       Assignment *a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
+      bool satisfies = true;
+      if (batch.isDetermined(i)) {
+        for (unsigned j = 0, je = constraints.size(); j != je; ++j)
+          if (batch.getValue(j, i) != 1) {
+            satisfies = false;
+            break;
+          }
+      } else {
+        satisfies = a->satisfies(key.begin(), key.end());
+      }
+      if (satisfies) {
         result = a;
         return true;
       }
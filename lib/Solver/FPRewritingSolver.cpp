@@ -140,6 +140,8 @@ bool collectFMinMax(ref<Expr> &e, std::set<ref<Expr> > &ops, MinMax &mm) {
   return false;
 }
 
+bool HasFPExpr(ref<Expr> e);
+
 /* Given a pair of floating point expressions lhs and rhs, return an expression
  * which is a sufficient condition for lhs == rhs (unordered or bitwise
  * comparison) to hold
@@ -219,6 +221,17 @@ ref<Expr> FPRewritingSolver::constrainEquality(ref<Expr> lhs, ref<Expr> rhs, boo
         if (lhsCond == rhsCond)
           return ConstantExpr::alloc(1, Expr::Bool);
       }
+      // Selects with the same condition, as created when merging states,
+      // are equal if the arms picked by the condition are. The condition
+      // can only be kept if it is free of floating point (the rewritten
+      // query must be); otherwise both pairs of arms have to be equal.
+      if (lhsCond == rhs->getKid(0)) {
+        ref<Expr> trueEq = constrainEquality(lhs->getKid(1), rhs->getKid(1), isUnordered);
+        ref<Expr> falseEq = constrainEquality(lhs->getKid(2), rhs->getKid(2), isUnordered);
+        if (HasFPExpr(lhsCond))
+          return AndExpr::create(trueEq, falseEq);
+        return SelectExpr::create(lhsCond, trueEq, falseEq);
+      }
       std::set<ref<Expr> > lhsOps, rhsOps;
       MinMax lhsMM = mmUnknown, rhsMM = mmUnknown;
       if (collectFMinMax(lhs, lhsOps, lhsMM) &&
@@ -275,6 +288,10 @@ ref<Expr> FPRewritingSolver::_rewriteConstraint(const ref<Expr> &e, bool isNeg)
       if (e->getWidth() == 1)
         return AndExpr::create(_rewriteConstraint(e->getKid(0), isNeg), _rewriteConstraint(e->getKid(1), isNeg));
       break;
+    case Expr::Or:
+      if (e->getWidth() == 1)
+        return OrExpr::create(_rewriteConstraint(e->getKid(0), isNeg), _rewriteConstraint(e->getKid(1), isNeg));
+      break;
     case Expr::Eq: {
       ref<Expr> neg;
       if (e->isNotExpr(neg))
@@ -0,0 +1,25 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -DMAKE_SEED -c -o %t.seed.bc
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.seed.out %t.klee-out
+// RUN: %klee --output-dir=%t.seed.out %t.seed.bc
+// RUN: %klee --output-dir=%t.klee-out --concolic --seed-out=%t.seed.out/test000001.ktest %t.bc > %t.log
+// RUN: ls %t.klee-out/*.ktest | wc -l | grep -w 8
+// RUN: grep -c "res=" %t.log | grep -w 8
+
+#include <stdio.h>
+
+int main() {
+  int x, res = 0;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+
+#ifndef MAKE_SEED
+  if (x & 1) res += 1;
+  if (x & 2) res += 2;
+  if (x & 4) res += 4;
+
+  printf("res=%d\n", res);
+#endif
+
+  return res;
+}
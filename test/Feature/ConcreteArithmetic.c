@@ -0,0 +1,27 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: %klee --exit-on-error %t1.bc
+
+#include <assert.h>
+
+int main() {
+  volatile signed char c = -128;
+  volatile short s = -3;
+  volatile int i = -7;
+  volatile unsigned u = 0xF0000001u;
+  volatile long long ll = -9223372036854775807LL - 1;
+  volatile _Bool b = 1;
+
+  assert((signed char) (c - 1) == 127);
+  assert(i / 2 == -3 && i % 2 == -1);
+  assert(u / 16 == 0x0F000000u && u % 16 == 1);
+  assert((i >> 1) == -4);
+  assert((u >> 28) == 0xF);
+  assert((u << 4) == 0x10u);
+  assert((int) s == -3 && (unsigned short) s == 0xFFFD);
+  assert((long long) i == -7LL && (unsigned long long) (unsigned) i == 0xFFFFFFF9ULL);
+  assert(ll < 0 && (unsigned long long) ll > 0);
+  assert((b + b) == 2);
+  assert((i < 0 ? u : 0) == u);
+
+  return 0;
+}
@@ -0,0 +1,46 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: %klee --exit-on-error %t1.bc
+
+#include <assert.h>
+
+typedef int v4si __attribute__((vector_size(16)));
+typedef short v8hi __attribute__((vector_size(16)));
+typedef float v4sf __attribute__((vector_size(16)));
+typedef double v2df __attribute__((vector_size(16)));
+
+int main() {
+  volatile v4si a = { 1, -2, 0x7fffffff, 4 }, b = { 5, 6, 1, -8 };
+  volatile v8hi h = { 1, 2, 3, 4, -5, 6, 7, 0x7fff }, k = { 1, 1, 1, 1, 1, 1, 1, 1 };
+  volatile v4sf f = { 1.5f, -2.0f, 0.1f, 3.0f }, g = { 0.5f, 4.0f, 0.2f, -3.0f };
+  volatile v2df d = { 1.0, 1e300 }, e = { 3.0, 1e300 };
+  v4si ri;
+  v8hi rh;
+  v4sf rf;
+  v2df rd;
+
+  ri = a + b;
+  assert(((int*) &ri)[0] == 6 && ((int*) &ri)[1] == 4 &&
+         ((int*) &ri)[2] == (int) 0x80000000 && ((int*) &ri)[3] == -4);
+  ri = a * b;
+  assert(((int*) &ri)[1] == -12 && ((int*) &ri)[3] == -32);
+  ri = a / b;
+  assert(((int*) &ri)[0] == 0 && ((int*) &ri)[2] == 0x7fffffff);
+  ri = a >> (v4si) { 1, 1, 4, 2 };
+  assert(((int*) &ri)[1] == -1 && ((int*) &ri)[2] == 0x07ffffff);
+
+  rh = h + k;
+  assert(((short*) &rh)[4] == -4 && ((short*) &rh)[7] == (short) 0x8000);
+
+  rf = f + g;
+  assert(((float*) &rf)[0] == 2.0f && ((float*) &rf)[3] == 0.0f);
+  assert(((float*) &rf)[2] == 0.1f + 0.2f);
+  rf = f / g;
+  assert(((float*) &rf)[1] == -0.5f && ((float*) &rf)[3] == -1.0f);
+
+  rd = d / e;
+  assert(((double*) &rd)[0] == 1.0 / 3.0 && ((double*) &rd)[1] == 1.0);
+  rd = d * e;
+  assert(((double*) &rd)[1] > 1e308);
+
+  return 0;
+}
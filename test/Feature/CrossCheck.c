@@ -0,0 +1,26 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out --cross-check=add_simd,add_scalar %t.bc
+// RUN: not ls %t.klee-out/*.xcheck.err
+// RUN: %klee --output-dir=%t.klee-out2 --cross-check=abs_ref,abs_bad %t.bc
+// RUN: ls %t.klee-out2/*.xcheck.err | wc -l | grep -w 1
+
+typedef float v4sf __attribute__((vector_size(16)));
+
+void add_scalar(float *dst, float *src) {
+  int i;
+  for (i = 0; i < 4; i++)
+    dst[i] = dst[i] + src[i];
+}
+
+void add_simd(float *dst, float *src) {
+  *(v4sf *) dst = *(v4sf *) dst + *(v4sf *) src;
+}
+
+int abs_ref(int x) {
+  return x < 0 ? -x : x;
+}
+
+int abs_bad(int x) {
+  return x < -1 ? -x : x;
+}
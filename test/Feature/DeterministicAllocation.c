@@ -0,0 +1,23 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: %klee --allocate-deterministic --exit-on-error %t1.bc > %t1.log
+// RUN: %klee --allocate-deterministic --exit-on-error %t1.bc > %t2.log
+// RUN: diff %t1.log %t2.log
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main() {
+  int x;
+  char *a = malloc(10);
+  char *b = malloc(100);
+
+  printf("%p %p %p\n", (void*) &x, a, b);
+
+  // Freed addresses are quarantined rather than handed out again at once.
+  free(a);
+  char *c = malloc(10);
+  assert(c != a);
+
+  return 0;
+}
@@ -0,0 +1,22 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-paths --dump-states-on-halt --only-output-states-covering-new --stop-after-n-instructions=2000 %t.bc
+// RUN: grep -l "execution halting" %t.klee-out/*.early | wc -l | grep -w 8
+// RUN: ls %t.klee-out/*.path | wc -l | grep -w 8
+
+// Every state is still running when execution halts, and most of them
+// cover nothing new, but all of them are part of the frontier.
+
+int main() {
+  int x, n = 0;
+
+  klee_make_symbolic(&x, sizeof x);
+
+  for (;;) {
+    if (x & 1) n++;
+    if (x & 2) n++;
+    if (x & 4) n++;
+  }
+
+  return n;
+}
@@ -0,0 +1,18 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --instrument-simd %t.bc > %t.log
+// RUN: grep "^add 3$" %t.klee-out/run.simd
+// RUN: grep "SIMD" %t.klee-out/run.istats
+// RUN: not grep "SSE instr" %t.log
+
+typedef int v4si __attribute__((vector_size(16)));
+
+int main() {
+  v4si a = { 1, 2, 3, 4 }, b = { 5, 6, 7, 8 };
+  int i;
+
+  for (i = 0; i < 3; i++)
+    a = a + b;
+
+  return ((int*) &a)[0] != 16;
+}
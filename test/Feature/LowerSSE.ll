@@ -0,0 +1,83 @@
+; RUN: llvm-as %s -f -o %t1.bc
+; RUN: %klee -disable-opt %t1.bc > %t2 2>&1
+; RUN: grep PASS %t2
+; RUN: not grep "undefined reference" %t2
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i32 @puts(i8*)
+declare <8 x i16> @llvm.x86.ssse3.phadd.sw.128(<8 x i16>, <8 x i16>) nounwind readnone
+declare <16 x i8> @llvm.x86.ssse3.pshuf.b.128(<16 x i8>, <16 x i8>) nounwind readnone
+declare <4 x float> @llvm.x86.sse41.blendps(<4 x float>, <4 x float>, i32) nounwind readnone
+declare <4 x float> @llvm.x86.sse3.hadd.ps(<4 x float>, <4 x float>) nounwind readnone
+declare i32 @llvm.x86.sse2.pmovmskb.128(<16 x i8>) nounwind readnone
+declare <8 x i16> @llvm.x86.sse2.psrai.w(<8 x i16>, i32) nounwind readnone
+declare <8 x i16> @llvm.x86.sse2.pslli.w(<8 x i16>, i32) nounwind readnone
+
+@.passstr = private constant [5 x i8] c"PASS\00", align 1
+@.failstr = private constant [5 x i8] c"FAIL\00", align 1
+
+define i32 @main() nounwind {
+entry:
+  ; Horizontal saturating add.
+  %h = call <8 x i16> @llvm.x86.ssse3.phadd.sw.128(<8 x i16> <i16 32767, i16 1, i16 2, i16 3, i16 -32768, i16 -1, i16 0, i16 0>, <8 x i16> zeroinitializer)
+  %h0 = extractelement <8 x i16> %h, i32 0
+  %h1 = extractelement <8 x i16> %h, i32 1
+  %h2 = extractelement <8 x i16> %h, i32 2
+  %c0 = icmp eq i16 %h0, 32767
+  %c1 = icmp eq i16 %h1, 5
+  %c2 = icmp eq i16 %h2, -32768
+
+  ; Byte shuffle, a set top bit in the selector zeroes the byte.
+  %s = call <16 x i8> @llvm.x86.ssse3.pshuf.b.128(<16 x i8> <i8 0, i8 1, i8 2, i8 3, i8 4, i8 5, i8 6, i8 7, i8 8, i8 9, i8 10, i8 11, i8 12, i8 13, i8 14, i8 15>, <16 x i8> <i8 15, i8 -128, i8 3, i8 3, i8 3, i8 3, i8 3, i8 3, i8 3, i8 3, i8 3, i8 3, i8 3, i8 3, i8 3, i8 19>)
+  %s0 = extractelement <16 x i8> %s, i32 0
+  %s1 = extractelement <16 x i8> %s, i32 1
+  %s15 = extractelement <16 x i8> %s, i32 15
+  %c3 = icmp eq i8 %s0, 15
+  %c4 = icmp eq i8 %s1, 0
+  %c5 = icmp eq i8 %s15, 3
+
+  ; Immediate blend and horizontal float add.
+  %b = call <4 x float> @llvm.x86.sse41.blendps(<4 x float> <float 1.0, float 2.0, float 3.0, float 4.0>, <4 x float> <float 5.0, float 6.0, float 7.0, float 8.0>, i32 5)
+  %f = call <4 x float> @llvm.x86.sse3.hadd.ps(<4 x float> %b, <4 x float> %b)
+  %f0 = extractelement <4 x float> %f, i32 0
+  %f1 = extractelement <4 x float> %f, i32 1
+  %c6 = fcmp oeq float %f0, 7.0
+  %c7 = fcmp oeq float %f1, 11.0
+
+  ; Sign bits of the bytes.
+  %m = call i32 @llvm.x86.sse2.pmovmskb.128(<16 x i8> <i8 -1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 1, i8 -128>)
+  %c8 = icmp eq i32 %m, 32769
+
+  ; Immediate shifts by at least the lane width.
+  %sa = call <8 x i16> @llvm.x86.sse2.psrai.w(<8 x i16> <i16 -5, i16 5, i16 0, i16 0, i16 0, i16 0, i16 0, i16 0>, i32 20)
+  %sa0 = extractelement <8 x i16> %sa, i32 0
+  %sa1 = extractelement <8 x i16> %sa, i32 1
+  %c9 = icmp eq i16 %sa0, -1
+  %c10 = icmp eq i16 %sa1, 0
+  %sl = call <8 x i16> @llvm.x86.sse2.pslli.w(<8 x i16> <i16 1, i16 1, i16 1, i16 1, i16 1, i16 1, i16 1, i16 1>, i32 16)
+  %sl0 = extractelement <8 x i16> %sl, i32 0
+  %c11 = icmp eq i16 %sl0, 0
+
+  %a0 = and i1 %c0, %c1
+  %a1 = and i1 %a0, %c2
+  %a2 = and i1 %a1, %c3
+  %a3 = and i1 %a2, %c4
+  %a4 = and i1 %a3, %c5
+  %a5 = and i1 %a4, %c6
+  %a6 = and i1 %a5, %c7
+  %a7 = and i1 %a6, %c8
+  %a8 = and i1 %a7, %c9
+  %a9 = and i1 %a8, %c10
+  %ok = and i1 %a9, %c11
+  br i1 %ok, label %bbtrue, label %bbfalse
+
+bbtrue:
+  %0 = call i32 @puts(i8* getelementptr inbounds ([5 x i8]* @.passstr, i64 0, i64 0)) nounwind
+  ret i32 0
+
+bbfalse:
+  %1 = call i32 @puts(i8* getelementptr inbounds ([5 x i8]* @.failstr, i64 0, i64 0)) nounwind
+  ret i32 1
+}
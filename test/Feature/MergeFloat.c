@@ -0,0 +1,27 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-merge %t.bc
+// RUN: ls %t.klee-out/*.ktest | wc -l | grep -w 1
+
+void klee_merge(void);
+
+static float clamp(float x) {
+  if (x < 0.f) x = 0.f;
+  if (x > 1.f) x = 1.f;
+  return x;
+}
+
+int main() {
+  float v[4];
+  int i;
+
+  klee_make_symbolic(v, sizeof v);
+
+  // Without merging each clamp would multiply the number of states by 3.
+  for (i = 0; i < 4; i++) {
+    v[i] = clamp(v[i]);
+    klee_merge();
+  }
+
+  return 0;
+}
@@ -0,0 +1,41 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: %klee --exit-on-error %t1.bc
+
+#include <assert.h>
+
+typedef int v4si __attribute__((vector_size(16)));
+typedef float v4sf __attribute__((vector_size(16)));
+
+int main() {
+  int x;
+  float y;
+  klee_make_symbolic(&x, sizeof x, "x");
+  klee_make_symbolic(&y, sizeof y, "y");
+
+  // Only lane 2 is symbolic; the other lanes are computed concretely.
+  volatile v4si a = { 1, -2, x, 4 }, b = { 5, 6, 1, -8 };
+  volatile v4sf f = { 1.5f, -2.0f, y, 3.0f }, g = { 0.5f, 4.0f, 0.25f, -3.0f };
+  v4si ri;
+  v4sf rf;
+
+  ri = a + b;
+  assert(((int*) &ri)[0] == 6 && ((int*) &ri)[1] == 4 &&
+         ((int*) &ri)[2] == x + 1 && ((int*) &ri)[3] == -4);
+  ri = a * b;
+  assert(((int*) &ri)[1] == -12 && ((int*) &ri)[2] == x &&
+         ((int*) &ri)[3] == -32);
+
+  // The symbolic float lane is compared bitwise with the same scalar
+  // operation, since float equality on symbolic values is not decided
+  // exactly.
+  float s;
+  rf = f + g;
+  s = y + 0.25f;
+  assert(((float*) &rf)[0] == 2.0f && ((float*) &rf)[1] == 2.0f &&
+         ((int*) &rf)[2] == *(int*) &s && ((float*) &rf)[3] == 0.0f);
+  rf = f * g;
+  s = y * 0.25f;
+  assert(((int*) &rf)[2] == *(int*) &s && ((float*) &rf)[3] == -9.0f);
+
+  return 0;
+}
@@ -0,0 +1,18 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --prune-redundant-states %t.bc
+// RUN: ls %t.klee-out/*.ktest | wc -l | grep -w 1
+// RUN: tail -n 1 %t.klee-out/run.stats | grep ",1)$"
+
+int main() {
+  int x;
+
+  klee_make_symbolic(&x, sizeof x);
+
+  // Once x is known to be zero every iteration leaves the state unchanged,
+  // so the looping path is pruned instead of running forever.
+  while (!x)
+    ;
+
+  return 0;
+}
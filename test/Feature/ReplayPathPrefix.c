@@ -0,0 +1,27 @@
+// RUN: echo "1" > %t1.path
+// RUN: echo "0" >> %t1.path
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t2.bc
+// RUN: rm -rf %t.out
+// RUN: %klee --output-dir=%t.out --replay-path %t1.path --replay-path-prefix %t2.bc > %t3.log
+// RUN: grep -q "res: 110" %t3.log
+// RUN: grep -q "res: 22" %t3.log
+// RUN: test -f %t.out/test000002.ktest
+// RUN: not test -f %t.out/test000003.ktest
+
+int main() {
+  int res = 1;
+  int x;
+
+  klee_make_symbolic(&x, sizeof x);
+
+  if (x&1) res *= 2;
+  if (x&2) res *= 3;
+  if (x&4) res *= 5;
+
+  // get forced branch coverage
+  if (x&2) res *= 7;
+  if (!(x&2)) res *= 11;
+  printf("res: %d\n", res);
+ 
+  return 0;
+}
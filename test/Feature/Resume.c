@@ -0,0 +1,21 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.first %t.second
+// RUN: %klee --output-dir=%t.first --checkpoint-interval=3600 --stop-after-n-instructions=300 %t.bc
+// RUN: test -f %t.first/checkpoint
+// RUN: %klee --output-dir=%t.second --resume=%t.first/checkpoint %t.bc
+// RUN: ls %t.first/*.ktest %t.second/*.ktest | wc -l | grep -w 8
+
+int main() {
+  int i, x, res = 0;
+
+  klee_make_symbolic(&x, sizeof x);
+
+  if (x & 1) res += 1;
+  for (i=0; i<10; i++) res ^= i;
+  if (x & 2) res += 2;
+  for (i=0; i<10; i++) res ^= i;
+  if (x & 4) res += 4;
+  for (i=0; i<10; i++) res ^= i;
+
+  return res;
+}
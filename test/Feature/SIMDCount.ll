@@ -0,0 +1,31 @@
+; RUN: llvm-as %s -f -o %t1.bc
+; RUN: cp %t1.bc %t2.bc
+; RUN: simd-count -j 2 -format=csv -o %t.csv %t1.bc %t2.bc
+; RUN: grep "^instruction,,,add,2,0$" %t.csv
+; RUN: grep "^instruction,,,llvm.x86.sse41.round.ps,2,1$" %t.csv
+; RUN: grep "^instruction,,,llvm.x86.ssse3.pabs.d.128,2,0$" %t.csv
+; RUN: simd-count -format=json -o %t.json %t1.bc
+; RUN: grep "\"modules\": 1," %t.json
+; RUN: grep "\"function\": \"f\", \"count\": 3" %t.json
+; RUN: simd-count -o %t.simd %t1.bc
+; RUN: grep "^f,entry,add$" %t.simd
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare <4 x float> @llvm.x86.sse41.round.ps(<4 x float>, i32) nounwind readnone
+declare <4 x i32> @llvm.x86.ssse3.pabs.d.128(<4 x i32>) nounwind readnone
+
+define <4 x float> @f(<4 x i32> %a, <4 x float> %b) nounwind {
+entry:
+  %s = add <4 x i32> %a, %a
+  %p = call <4 x i32> @llvm.x86.ssse3.pabs.d.128(<4 x i32> %s)
+  %r = call <4 x float> @llvm.x86.sse41.round.ps(<4 x float> %b, i32 1)
+  ret <4 x float> %r
+}
+
+define i32 @g(i32 %x) nounwind {
+entry:
+  %y = add i32 %x, 1
+  ret i32 %y
+}
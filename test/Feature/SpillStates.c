@@ -0,0 +1,30 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=20 --spill-states %t.bc
+// RUN: ls %t.klee-out/*.ktest | wc -l | grep -w 32
+
+#include <stdlib.h>
+#include <string.h>
+
+int main() {
+  int i, x, n = 0;
+  char *buf;
+
+  klee_make_symbolic(&x, sizeof x);
+
+  if (x & 1) n += 1;
+  if (x & 2) n += 2;
+  if (x & 4) n += 4;
+  if (x & 8) n += 8;
+  if (x & 16) n += 16;
+
+  // 2 MBs per state, well over the cap across all states.
+  buf = malloc(1 << 21);
+  memset(buf, n, 1 << 21);
+
+  // Ensure we hit the periodic check
+  for (i=0; i<100000; i++)
+    n += buf[i];
+
+  return n;
+}
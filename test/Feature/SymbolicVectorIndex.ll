@@ -0,0 +1,51 @@
+; RUN: llvm-as %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out -disable-opt %t1.bc > %t2
+; RUN: grep PASS %t2
+; RUN: not grep FAIL %t2
+; RUN: ls %t.klee-out/*.ktest | wc -l | grep -w 2
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i32 @puts(i8*)
+declare void @klee_make_symbolic(i8*, i64, i8*)
+
+@.passstr = private constant [5 x i8] c"PASS\00", align 1
+@.failstr = private constant [5 x i8] c"FAIL\00", align 1
+@.idxstr = private constant [4 x i8] c"idx\00", align 1
+
+; Inserting into and extracting from a symbolic lane must not fork on the
+; index: one path for the in-range index and one for the out-of-range one.
+define i32 @main() nounwind {
+entry:
+  %p = alloca i32, align 4
+  %p8 = bitcast i32* %p to i8*
+  call void @klee_make_symbolic(i8* %p8, i64 4, i8* getelementptr inbounds ([4 x i8]* @.idxstr, i64 0, i64 0))
+  %idx = load i32* %p, align 4
+  %inrange = icmp ult i32 %idx, 4
+  br i1 %inrange, label %bbvec, label %bbexit
+
+bbvec:
+  %v = insertelement <4 x i32> <i32 10, i32 20, i32 30, i32 40>, i32 25, i32 %idx
+  %e = extractelement <4 x i32> %v, i32 %idx
+  %old = extractelement <4 x i32> <i32 10, i32 20, i32 30, i32 40>, i32 %idx
+  %sum = add i32 %e, %old
+  %lo = icmp ugt i32 %sum, 34
+  %hi = icmp ult i32 %sum, 66
+  %ok0 = and i1 %lo, %hi
+  %is25 = icmp eq i32 %e, 25
+  %ok = and i1 %ok0, %is25
+  br i1 %ok, label %bbtrue, label %bbfalse
+
+bbtrue:
+  %0 = call i32 @puts(i8* getelementptr inbounds ([5 x i8]* @.passstr, i64 0, i64 0)) nounwind
+  ret i32 0
+
+bbfalse:
+  %1 = call i32 @puts(i8* getelementptr inbounds ([5 x i8]* @.failstr, i64 0, i64 0)) nounwind
+  ret i32 1
+
+bbexit:
+  ret i32 0
+}
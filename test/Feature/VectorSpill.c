@@ -0,0 +1,32 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t1.bc
+// RUN: ls %t.klee-out/*.ktest | wc -l | grep -w 1
+
+#include <assert.h>
+
+typedef int v4si __attribute__((vector_size(16)));
+
+union vec {
+  v4si v;
+  int i[4];
+};
+
+int main() {
+  int x[4];
+  union vec a, b;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  // The stores and reloads below go through whole-vector spans; lane reads
+  // and partial overwrites must still see the right bytes.
+  a.v = *(v4si *) x + *(v4si *) x;
+  b.v = a.v;
+  assert(b.i[2] == x[2] * 2);
+
+  a.i[1] = 7;
+  b.v = a.v;
+  assert(b.i[1] == 7 && b.i[0] == x[0] * 2 && b.i[3] == x[3] * 2);
+
+  return 0;
+}
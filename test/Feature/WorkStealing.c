@@ -0,0 +1,30 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.dir %t.w0 %t.w1
+// RUN: mkdir %t.dir
+//
+// Worker 1 is idle from the start, and done as far as worker 0's exit is
+// concerned, so worker 0 hands it states and then stops.
+// RUN: touch %t.dir/request.1 %t.dir/done.1
+// RUN: %klee --output-dir=%t.w0 --num-workers=2 --worker-id=0 --worker-split-states=2 --worker-dir=%t.dir --worker-poll-interval=0 %t.bc
+// RUN: grep -q "gave [1-9][0-9]* states to worker 1" %t.w0/messages.txt
+// RUN: test -f %t.dir/work.1
+// RUN: test -f %t.dir/done.0
+//
+// RUN: rm %t.dir/done.1
+// RUN: %klee --output-dir=%t.w1 --num-workers=2 --worker-id=1 --worker-split-states=2 --worker-dir=%t.dir --worker-poll-interval=0 %t.bc
+// RUN: grep -q "took [1-9][0-9]* states" %t.w1/messages.txt
+// RUN: ls %t.w0/*.ktest %t.w1/*.ktest | wc -l | grep -w 8
+
+#include <assert.h>
+
+int main() {
+  int x, res = 0;
+
+  klee_make_symbolic(&x, sizeof x);
+
+  if (x & 1) res += 1;
+  if (x & 2) res += 2;
+  if (x & 4) res += 4;
+
+  return res;
+}
@@ -0,0 +1,21 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.w0 %t.w1
+// RUN: %klee --output-dir=%t.w0 --num-workers=2 --worker-id=0 --worker-split-states=2 %t.bc
+// RUN: %klee --output-dir=%t.w1 --num-workers=2 --worker-id=1 --worker-split-states=2 %t.bc
+// RUN: test -f %t.w0/test000001.ktest
+// RUN: test -f %t.w1/test000001.ktest
+// RUN: ls %t.w0/*.ktest %t.w1/*.ktest | wc -l | grep -w 8
+
+#include <assert.h>
+
+int main() {
+  int x, res = 0;
+
+  klee_make_symbolic(&x, sizeof x);
+
+  if (x & 1) res += 1;
+  if (x & 2) res += 2;
+  if (x & 4) res += 4;
+
+  return res;
+}
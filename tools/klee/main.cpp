@@ -14,6 +14,7 @@
 #include "klee/Internal/System/Time.h"
 
 #include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
 #include "llvm/Module.h"
 #if (LLVM_VERSION_MAJOR == 2 && LLVM_VERSION_MINOR < 7)
 #include "llvm/ModuleProvider.h"
@@ -27,6 +28,7 @@
 #endif
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/IRBuilder.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 
@@ -188,6 +190,16 @@ namespace {
   Watchdog("watchdog",
            cl::desc("Use a watchdog process to enforce --max-time."),
            cl::init(0));
+
+  cl::opt<std::string>
+  CrossCheck("cross-check",
+             cl::desc("Run two functions of the same type on shared symbolic inputs instead of main, and report any lane where their results differ"),
+             cl::value_desc("function1,function2"));
+
+  cl::opt<unsigned>
+  CrossCheckBufferSize("cross-check-buffer-size",
+                       cl::desc("Size in bytes of the buffer passed for each pointer argument of the cross-checked functions (default=64)"),
+                       cl::init(64));
 }
 
 extern cl::opt<double> MaxTime;
@@ -501,12 +513,9 @@ void KleeHandler::loadPathFile(std::string name,
   if (!f.good())
     assert(0 && "unable to open path file");
 
-  while (f.good()) {
-    unsigned value;
-    f >> value;
+  unsigned value;
+  while (f >> value)
     buffer.push_back(!!value);
-    f.get();
-  }
 }
 
 void KleeHandler::getOutFiles(std::string path,
@@ -1068,6 +1077,184 @@ static llvm::Module *linkWithUclibc(llvm::Module *mainModule) {
 }
 #endif
 
+/// Compares \arg v1 and \arg v2 bitwise, one vector lane at a time, and
+/// reports the first lane that differs as an error of the current path.
+static void emitCrossCheckLane(IRBuilder<> &builder, Function *harness,
+                               Value *v1, Value *v2, const std::string &what,
+                               Constant *reportErrorFn) {
+  LLVMContext &ctx = getGlobalContext();
+  unsigned bits = v1->getType()->getPrimitiveSizeInBits();
+  const Type *it = IntegerType::get(ctx, bits);
+  Value *eq = builder.CreateICmpEQ(builder.CreateBitCast(v1, it),
+                                   builder.CreateBitCast(v2, it));
+
+  BasicBlock *mismatch = BasicBlock::Create(ctx, "mismatch", harness);
+  BasicBlock *next = BasicBlock::Create(ctx, "next", harness);
+  builder.CreateCondBr(eq, next, mismatch);
+
+  builder.SetInsertPoint(mismatch);
+  std::string msg = "cross-check mismatch: " + CrossCheck + " differ in " + what;
+  Value *args[4] = {
+    builder.CreateConstGEP2_32(builder.CreateGlobalString("cross-check"), 0, 0),
+    ConstantInt::get(Type::getInt32Ty(ctx), 0),
+    builder.CreateConstGEP2_32(builder.CreateGlobalString(msg.c_str()), 0, 0),
+    builder.CreateConstGEP2_32(builder.CreateGlobalString("xcheck.err"), 0, 0)
+  };
+  builder.CreateCall(reportErrorFn, args, args + 4);
+  builder.CreateUnreachable();
+
+  builder.SetInsertPoint(next);
+}
+
+static void emitCrossCheckValue(IRBuilder<> &builder, Function *harness,
+                                Value *v1, Value *v2, const std::string &what,
+                                Constant *reportErrorFn) {
+  const VectorType *vt = dyn_cast<VectorType>(v1->getType());
+  if (!vt) {
+    emitCrossCheckLane(builder, harness, v1, v2, what, reportErrorFn);
+    return;
+  }
+
+  const Type *i32 = Type::getInt32Ty(getGlobalContext());
+  for (unsigned i = 0; i < vt->getNumElements(); ++i) {
+    std::stringstream lane;
+    lane << what << " lane " << i;
+    Constant *ic = ConstantInt::get(i32, i);
+    emitCrossCheckLane(builder, harness,
+                       builder.CreateExtractElement(v1, ic),
+                       builder.CreateExtractElement(v2, ic),
+                       lane.str(), reportErrorFn);
+  }
+}
+
+/// Builds an entry function for --cross-check. Each argument of the two
+/// functions is made symbolic once; scalars are passed to both as they
+/// are, pointers get a buffer each with the same symbolic contents. After
+/// both calls the return values and the buffers are compared lane by
+/// lane, so the paths fork on the shared inputs and each comparison goes
+/// through the FP rewriting solver's structural equality first.
+static Function *createCrossCheckMain(Module *mainModule) {
+  std::string::size_type comma = CrossCheck.find(',');
+  if (comma == std::string::npos)
+    klee_error("--cross-check expects two comma separated function names");
+
+  std::string name1 = CrossCheck.substr(0, comma);
+  std::string name2 = CrossCheck.substr(comma + 1);
+  Function *f1 = mainModule->getFunction(name1);
+  Function *f2 = mainModule->getFunction(name2);
+  if (!f1 || f1->isDeclaration())
+    klee_error("--cross-check function not found: %s", name1.c_str());
+  if (!f2 || f2->isDeclaration())
+    klee_error("--cross-check function not found: %s", name2.c_str());
+
+  const FunctionType *ft = f1->getFunctionType();
+  if (f2->getFunctionType() != ft)
+    klee_error("--cross-check functions %s and %s have different types",
+               name1.c_str(), name2.c_str());
+  if (ft->isVarArg())
+    klee_error("--cross-check does not support variadic functions");
+  if (ft->getReturnType() != Type::getVoidTy(getGlobalContext()) &&
+      !ft->getReturnType()->getPrimitiveSizeInBits())
+    klee_error("--cross-check cannot compare the return values of %s",
+               name1.c_str());
+
+  LLVMContext &ctx = getGlobalContext();
+  const Type *i8 = Type::getInt8Ty(ctx);
+  const Type *i32 = Type::getInt32Ty(ctx);
+  const Type *sizeTy = mainModule->getPointerSize() == Module::Pointer32 ?
+    i32 : Type::getInt64Ty(ctx);
+  const Type *i8p = PointerType::getUnqual(i8);
+
+  Constant *makeSymbolicFn =
+    mainModule->getOrInsertFunction("klee_make_symbolic",
+                                    Type::getVoidTy(ctx),
+                                    i8p, sizeTy, i8p, NULL);
+  Constant *reportErrorFn =
+    mainModule->getOrInsertFunction("klee_report_error",
+                                    Type::getVoidTy(ctx),
+                                    i8p, i32, i8p, i8p, NULL);
+
+  Function *harness =
+    Function::Create(FunctionType::get(i32, std::vector<const Type*>(), false),
+                     GlobalVariable::ExternalLinkage,
+                     "__klee_cross_check",
+                     mainModule);
+  IRBuilder<> builder(BasicBlock::Create(ctx, "entry", harness));
+
+  std::vector<Value*> args1, args2;
+  std::vector<unsigned> bufferArgs;
+  for (unsigned i = 0; i != ft->getNumParams(); ++i) {
+    const Type *t = ft->getParamType(i);
+    std::stringstream name;
+    name << "arg" << i;
+    Value *nameStr =
+      builder.CreateConstGEP2_32(builder.CreateGlobalString(name.str().c_str()), 0, 0);
+
+    if (isa<PointerType>(t)) {
+      const Type *bufTy = ArrayType::get(i8, CrossCheckBufferSize);
+      AllocaInst *buf1 = builder.CreateAlloca(bufTy);
+      AllocaInst *buf2 = builder.CreateAlloca(bufTy);
+      buf1->setAlignment(16);
+      buf2->setAlignment(16);
+      Value *symArgs[3] = { builder.CreateBitCast(buf1, i8p),
+                            ConstantInt::get(sizeTy, CrossCheckBufferSize),
+                            nameStr };
+      builder.CreateCall(makeSymbolicFn, symArgs, symArgs + 3);
+      builder.CreateStore(builder.CreateLoad(buf1), buf2);
+      args1.push_back(builder.CreateBitCast(buf1, t));
+      args2.push_back(builder.CreateBitCast(buf2, t));
+      bufferArgs.push_back(i);
+    } else {
+      unsigned bytes = (t->getPrimitiveSizeInBits() + 7) / 8;
+      if (!bytes)
+        klee_error("--cross-check cannot make argument %u symbolic", i);
+      AllocaInst *v = builder.CreateAlloca(t);
+      Value *symArgs[3] = { builder.CreateBitCast(v, i8p),
+                            ConstantInt::get(sizeTy, bytes),
+                            nameStr };
+      builder.CreateCall(makeSymbolicFn, symArgs, symArgs + 3);
+      Value *arg = builder.CreateLoad(v);
+      args1.push_back(arg);
+      args2.push_back(arg);
+    }
+  }
+
+  Value *res1 = builder.CreateCall(f1, args1.begin(), args1.end());
+  Value *res2 = builder.CreateCall(f2, args2.begin(), args2.end());
+
+  if (ft->getReturnType() != Type::getVoidTy(ctx))
+    emitCrossCheckValue(builder, harness, res1, res2, "return value",
+                        reportErrorFn);
+
+  // Buffers are compared in lanes of the pointee type where it has one.
+  for (std::vector<unsigned>::iterator it = bufferArgs.begin(),
+         ie = bufferArgs.end(); it != ie; ++it) {
+    const Type *laneTy = cast<PointerType>(ft->getParamType(*it))->getElementType();
+    if (const VectorType *vt = dyn_cast<VectorType>(laneTy))
+      laneTy = vt->getElementType();
+    unsigned laneBits = laneTy->getPrimitiveSizeInBits();
+    if (!laneBits || laneBits % 8 || (CrossCheckBufferSize * 8) % laneBits) {
+      laneTy = i8;
+      laneBits = 8;
+    }
+
+    const Type *lanePtrTy = PointerType::getUnqual(laneTy);
+    Value *p1 = builder.CreateBitCast(args1[*it], lanePtrTy);
+    Value *p2 = builder.CreateBitCast(args2[*it], lanePtrTy);
+    for (unsigned i = 0; i != CrossCheckBufferSize * 8 / laneBits; ++i) {
+      std::stringstream what;
+      what << "arg" << *it << " lane " << i;
+      emitCrossCheckLane(builder, harness,
+                         builder.CreateLoad(builder.CreateConstGEP1_32(p1, i)),
+                         builder.CreateLoad(builder.CreateConstGEP1_32(p2, i)),
+                         what.str(), reportErrorFn);
+    }
+  }
+
+  builder.CreateRet(ConstantInt::get(i32, 0));
+  return harness;
+}
+
 int main(int argc, char **argv, char **envp) {  
 #if ENABLE_STPLOG == 1
   STPLOG_init("stplog.c");
@@ -1220,7 +1407,8 @@ int main(int argc, char **argv, char **envp) {
 
   // Get the desired main function.  klee_main initializes uClibc
   // locale and other data and then calls main.
-  Function *mainFn = mainModule->getFunction("main");
+  Function *mainFn = CrossCheck.empty() ? mainModule->getFunction("main")
+                                        : createCrossCheckMain(mainModule);
   if (!mainFn) {
     std::cerr << "'main' function not found in module.\n";
     return -1;
@@ -1295,6 +1483,7 @@ int main(int argc, char **argv, char **envp) {
   char buf[256];
   time_t t[2];
   t[0] = time(NULL);
+  double startWallTime = util::getWallTime();
   strftime(buf, sizeof(buf), "Started: %Y-%m-%d %H:%M:%S\n", localtime(&t[0]));
   infoFile << buf;
   infoFile.flush();
@@ -1396,6 +1585,7 @@ int main(int argc, char **argv, char **envp) {
   }
       
   t[1] = time(NULL);
+  double elapsedWallTime = util::getWallTime() - startWallTime;
   strftime(buf, sizeof(buf), "Finished: %Y-%m-%d %H:%M:%S\n", localtime(&t[1]));
   infoFile << buf;
 
@@ -1439,6 +1629,10 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
     << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+  if (elapsedWallTime > 0)
+    handler->getInfoStream() 
+      << "KLEE: done: instructions per second = " 
+      << (uint64_t) (instructions / elapsedWallTime) << "\n";
 
   std::stringstream stats;
   stats << "\n";
@@ -20,76 +20,384 @@
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/System/Signals.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
 #include <memory>
+#include <set>
+#include <vector>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 using namespace llvm;
 
-static cl::opt<std::string>
-InputFilename(cl::Positional, cl::desc("<input bitcode>"), cl::init("-"));
+namespace {
+  enum OutputFormat {
+    SIMDFormat, JSONFormat, CSVFormat
+  };
+}
+
+static cl::list<std::string>
+InputFilenames(cl::Positional, cl::desc("<input bitcode>..."), cl::ZeroOrMore);
 
 static cl::opt<std::string>
 OutputFilename("o", cl::desc("Override output filename"),
                cl::value_desc("filename"));
 
-int main(int argc, char **argv) {
-  // Print a stack trace if we signal out.
-  sys::PrintStackTraceOnErrorSignal();
-  PrettyStackTraceProgram X(argc, argv);
-  
-  LLVMContext &Context = getGlobalContext();
-  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
-  
-  
-  cl::ParseCommandLineOptions(argc, argv, "LLVM .bc SIMD instruction counter\n");
+static cl::opt<OutputFormat>
+Format("format",
+       cl::desc("Output format"),
+       cl::values(clEnumValN(SIMDFormat, "simd", "One line per SIMD instruction, in a .simd file per input (default)"),
+                  clEnumValN(JSONFormat, "json", "Per function and per instruction histograms of all inputs as JSON"),
+                  clEnumValN(CSVFormat, "csv", "Per function and per instruction histograms of all inputs as CSV"),
+                  clEnumValEnd),
+       cl::init(SIMDFormat));
+
+static cl::opt<unsigned>
+Jobs("j", cl::desc("Number of worker processes (default=1)"),
+     cl::init(1));
+
+namespace {
+  /// SIMD instruction counts of one or more modules.
+  struct SIMDCounts {
+    typedef std::pair<std::string, std::string> FunctionKey;
+
+    std::map<FunctionKey, uint64_t> functions;
+    std::map<std::string, uint64_t> names;
+    std::set<std::string> unsupported;
+    unsigned modules, failures;
+
+    SIMDCounts() : modules(0), failures(0) {}
 
+    uint64_t total() const {
+      uint64_t sum = 0;
+      for (std::map<std::string, uint64_t>::const_iterator
+             it = names.begin(), ie = names.end(); it != ie; ++it)
+        sum += it->second;
+      return sum;
+    }
+  };
+}
+
+/// Counts the SIMD instructions of \arg path into \arg counts, and lists
+/// them in its .simd file if that format was asked for.
+static void countModule(const std::string &path, SIMDCounts &counts) {
+  // Each module gets a context of its own, so nothing is kept alive
+  // between inputs.
+  LLVMContext Context;
   std::string ErrorMessage;
   std::auto_ptr<Module> M;
- 
+
   if (MemoryBuffer *Buffer
-         = MemoryBuffer::getFileOrSTDIN(InputFilename, &ErrorMessage)) {
+         = MemoryBuffer::getFileOrSTDIN(path, &ErrorMessage)) {
     M.reset(ParseBitcodeFile(Buffer, Context, &ErrorMessage));
     delete Buffer;
   }
 
   if (M.get() == 0) {
-    errs() << argv[0] << ": ";
+    errs() << path << ": ";
     if (ErrorMessage.size())
       errs() << ErrorMessage << "\n";
     else
       errs() << "bitcode didn't read correctly.\n";
-    return 1;
-  }
-  
-  if (OutputFilename.empty()) { // Unspecified output, infer it.
-    if (InputFilename == "-") {
-      OutputFilename = "-";
-    } else {
-      OutputFilename = InputFilename+".simd";
-    }
+    ++counts.failures;
+    return;
   }
 
-  // Make sure that the Out file gets unlinked from the disk if we get a
-  // SIGINT.
-  if (OutputFilename != "-")
-    sys::RemoveFileOnSignal(sys::Path(OutputFilename));
-
-  std::string ErrorInfo;
-  std::auto_ptr<raw_fd_ostream> 
-  Out(new raw_fd_ostream(OutputFilename.c_str(), ErrorInfo,
-                         raw_fd_ostream::F_Binary));
-  if (!ErrorInfo.empty()) {
-    errs() << ErrorInfo << '\n';
-    return 1;
+  std::auto_ptr<raw_fd_ostream> Out;
+  if (Format == SIMDFormat) {
+    std::string OutName = OutputFilename;
+    if (OutName.empty()) // Unspecified output, infer it.
+      OutName = path == "-" ? "-" : path + ".simd";
+
+    // Make sure that the Out file gets unlinked from the disk if we get a
+    // SIGINT.
+    if (OutName != "-")
+      sys::RemoveFileOnSignal(sys::Path(OutName));
+
+    std::string ErrorInfo;
+    Out.reset(new raw_fd_ostream(OutName.c_str(), ErrorInfo,
+                                 raw_fd_ostream::F_Binary));
+    if (!ErrorInfo.empty()) {
+      errs() << ErrorInfo << '\n';
+      ++counts.failures;
+      return;
+    }
   }
 
   for (Module::iterator f = M->begin(), fe = M->end(); f != fe; ++f)
     for (Function::iterator b = f->begin(), be = f->end(); b != be; ++b)
       for (BasicBlock::iterator i = b->begin(), ie = b->end(); i != ie; ++i)
         if (klee::isSIMDInstruction(i)) {
-          *Out << i->getParent()->getParent()->getName() << "," << i->getParent()->getName() << ",";
-          *Out << klee::getIntrinsicOrInstructionName(i);
-          *Out << "\n";
+          std::string name = klee::getIntrinsicOrInstructionName(i).str();
+          if (Out.get()) {
+            *Out << f->getName() << "," << b->getName() << ",";
+            *Out << name;
+            *Out << "\n";
+          }
+          ++counts.functions[SIMDCounts::FunctionKey(path, f->getName().str())];
+          ++counts.names[name];
+          if (klee::isUnsupportedSIMDIntrinsic(i))
+            counts.unsupported.insert(name);
         }
 
-  return 0;
+  ++counts.modules;
 }
 
+/***/
+
+// Workers hand their counts back to the parent as lines of the form
+// "<kind> <count> <key>", with the key running to the end of the line.
+
+static void writeCounts(FILE *f, const SIMDCounts &counts) {
+  fprintf(f, "m %u\n", counts.modules);
+  fprintf(f, "x %u\n", counts.failures);
+  for (std::map<SIMDCounts::FunctionKey, uint64_t>::const_iterator
+         it = counts.functions.begin(), ie = counts.functions.end();
+       it != ie; ++it)
+    fprintf(f, "f %llu %s\t%s\n", (unsigned long long) it->second,
+            it->first.first.c_str(), it->first.second.c_str());
+  for (std::map<std::string, uint64_t>::const_iterator
+         it = counts.names.begin(), ie = counts.names.end(); it != ie; ++it)
+    fprintf(f, "n %llu %s\n", (unsigned long long) it->second,
+            it->first.c_str());
+  for (std::set<std::string>::const_iterator
+         it = counts.unsupported.begin(), ie = counts.unsupported.end();
+       it != ie; ++it)
+    fprintf(f, "u 0 %s\n", it->c_str());
+}
+
+static bool readLine(FILE *f, std::string &line) {
+  line.clear();
+  int c;
+  while ((c = fgetc(f)) != EOF && c != '\n')
+    line += (char) c;
+  return c != EOF || !line.empty();
+}
+
+static void readCounts(FILE *f, SIMDCounts &counts) {
+  std::string line;
+  while (readLine(f, line)) {
+    char kind;
+    unsigned long long count;
+    int keyStart = 0;
+    if (sscanf(line.c_str(), "%c %llu %n", &kind, &count, &keyStart) < 2)
+      continue;
+    std::string key = line.substr(keyStart);
+
+    switch (kind) {
+    case 'm': counts.modules += count; break;
+    case 'x': counts.failures += count; break;
+    case 'f': {
+      std::string::size_type tab = key.find('\t');
+      counts.functions[SIMDCounts::FunctionKey(key.substr(0, tab),
+                                               key.substr(tab + 1))] += count;
+      break;
+    }
+    case 'n': counts.names[key] += count; break;
+    case 'u': counts.unsupported.insert(key); break;
+    }
+  }
+}
+
+/// Splits the inputs over \arg jobs forked workers, each of which writes
+/// its counts to a temporary file that is merged once it has exited.
+static void countModulesInWorkers(unsigned jobs, SIMDCounts &counts) {
+  std::vector<std::pair<pid_t, FILE*> > workers;
+
+  for (unsigned w = 0; w != jobs; ++w) {
+    FILE *f = tmpfile();
+    if (!f) {
+      perror("simd-count: tmpfile");
+      exit(1);
+    }
+
+    fflush(0);
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("simd-count: fork");
+      exit(1);
+    }
+
+    if (pid == 0) {
+      SIMDCounts local;
+      for (unsigned i = w; i < InputFilenames.size(); i += jobs)
+        countModule(InputFilenames[i], local);
+      writeCounts(f, local);
+      fclose(f);
+      _exit(0);
+    }
+
+    workers.push_back(std::make_pair(pid, f));
+  }
+
+  for (unsigned w = 0; w != workers.size(); ++w) {
+    int status;
+    if (waitpid(workers[w].first, &status, 0) < 0 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      errs() << "simd-count: worker " << w << " failed\n";
+      ++counts.failures;
+    } else {
+      rewind(workers[w].second);
+      readCounts(workers[w].second, counts);
+    }
+    fclose(workers[w].second);
+  }
+}
+
+/***/
+
+namespace {
+  /// Orders histogram entries by decreasing count.
+  template<class Key>
+  struct CompareCounts {
+    bool operator()(const std::pair<uint64_t, Key> &a,
+                    const std::pair<uint64_t, Key> &b) const {
+      return a.first > b.first;
+    }
+  };
+}
+
+template<class Key>
+static void sortByCount(const std::map<Key, uint64_t> &m,
+                        std::vector<std::pair<uint64_t, Key> > &sorted) {
+  for (typename std::map<Key, uint64_t>::const_iterator
+         it = m.begin(), ie = m.end(); it != ie; ++it)
+    sorted.push_back(std::make_pair(it->second, it->first));
+  std::stable_sort(sorted.begin(), sorted.end(), CompareCounts<Key>());
+}
+
+static std::string jsonString(const std::string &s) {
+  std::string res = "\"";
+  for (std::string::const_iterator it = s.begin(), ie = s.end(); it != ie; ++it) {
+    switch (*it) {
+    case '"': res += "\\\""; break;
+    case '\\': res += "\\\\"; break;
+    case '\n': res += "\\n"; break;
+    case '\t': res += "\\t"; break;
+    default:
+      if ((unsigned char) *it < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char) *it);
+        res += buf;
+      } else {
+        res += *it;
+      }
+    }
+  }
+  return res + "\"";
+}
+
+static std::string csvField(const std::string &s) {
+  if (s.find_first_of(",\"\n") == std::string::npos)
+    return s;
+  std::string res = "\"";
+  for (std::string::const_iterator it = s.begin(), ie = s.end(); it != ie; ++it) {
+    if (*it == '"')
+      res += '"';
+    res += *it;
+  }
+  return res + "\"";
+}
+
+static void writeJSON(raw_ostream &os, const SIMDCounts &counts) {
+  std::vector<std::pair<uint64_t, SIMDCounts::FunctionKey> > functions;
+  std::vector<std::pair<uint64_t, std::string> > names;
+  sortByCount(counts.functions, functions);
+  sortByCount(counts.names, names);
+
+  os << "{\n";
+  os << "  \"modules\": " << counts.modules << ",\n";
+  os << "  \"failures\": " << counts.failures << ",\n";
+  os << "  \"total\": " << counts.total() << ",\n";
+
+  os << "  \"functions\": [";
+  for (unsigned i = 0; i != functions.size(); ++i) {
+    os << (i ? ",\n" : "\n");
+    os << "    { \"module\": " << jsonString(functions[i].second.first)
+       << ", \"function\": " << jsonString(functions[i].second.second)
+       << ", \"count\": " << functions[i].first << " }";
+  }
+  os << "\n  ],\n";
+
+  os << "  \"instructions\": [";
+  for (unsigned i = 0; i != names.size(); ++i) {
+    os << (i ? ",\n" : "\n");
+    os << "    { \"name\": " << jsonString(names[i].second)
+       << ", \"count\": " << names[i].first
+       << ", \"unsupported\": "
+       << (counts.unsupported.count(names[i].second) ? "true" : "false")
+       << " }";
+  }
+  os << "\n  ]\n";
+  os << "}\n";
+}
+
+static void writeCSV(raw_ostream &os, const SIMDCounts &counts) {
+  std::vector<std::pair<uint64_t, SIMDCounts::FunctionKey> > functions;
+  std::vector<std::pair<uint64_t, std::string> > names;
+  sortByCount(counts.functions, functions);
+  sortByCount(counts.names, names);
+
+  os << "kind,module,function,name,count,unsupported\n";
+  for (unsigned i = 0; i != functions.size(); ++i)
+    os << "function," << csvField(functions[i].second.first) << ","
+       << csvField(functions[i].second.second) << ",,"
+       << functions[i].first << ",\n";
+  for (unsigned i = 0; i != names.size(); ++i)
+    os << "instruction,,," << csvField(names[i].second) << ","
+       << names[i].first << ","
+       << (counts.unsupported.count(names[i].second) ? 1 : 0) << "\n";
+}
+
+int main(int argc, char **argv) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+
+
+  cl::ParseCommandLineOptions(argc, argv, "LLVM .bc SIMD instruction counter\n");
+
+  if (InputFilenames.empty())
+    InputFilenames.push_back("-");
+
+  if (Format == SIMDFormat && InputFilenames.size() > 1 &&
+      !OutputFilename.empty()) {
+    errs() << argv[0] << ": -o cannot be used with several inputs "
+           << "in the simd format\n";
+    return 1;
+  }
+
+  // Standard input can only be read once.
+  unsigned jobs = std::min((unsigned) Jobs, (unsigned) InputFilenames.size());
+  if (std::find(InputFilenames.begin(), InputFilenames.end(), "-") !=
+      InputFilenames.end())
+    jobs = 1;
+
+  SIMDCounts counts;
+  if (jobs <= 1) {
+    for (unsigned i = 0; i != InputFilenames.size(); ++i)
+      countModule(InputFilenames[i], counts);
+  } else {
+    countModulesInWorkers(jobs, counts);
+  }
+
+  if (Format != SIMDFormat) {
+    std::string OutName = OutputFilename.empty() ? "-" : OutputFilename;
+    std::string ErrorInfo;
+    raw_fd_ostream Out(OutName.c_str(), ErrorInfo, raw_fd_ostream::F_Binary);
+    if (!ErrorInfo.empty()) {
+      errs() << ErrorInfo << '\n';
+      return 1;
+    }
+
+    if (Format == JSONFormat)
+      writeJSON(Out, counts);
+    else
+      writeCSV(Out, counts);
+  }
+
+  return counts.failures ? 1 : 0;
+}
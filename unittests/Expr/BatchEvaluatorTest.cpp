@@ -0,0 +1,84 @@
+//===-- BatchEvaluatorTest.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/BatchEvaluator.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(BatchEvaluatorTest, MatchesAssignment) {
+  Array *array = new Array("arr", 4);
+  ref<Expr> x = Expr::createTempRead(array, 32);
+  ref<Expr> b0 = ReadExpr::create(UpdateList(array, 0),
+                                  ConstantExpr::create(0, Expr::Int32));
+
+  std::vector< ref<Expr> > roots;
+  roots.push_back(AddExpr::create(x, ConstantExpr::create(7, Expr::Int32)));
+  roots.push_back(SltExpr::create(x, ConstantExpr::create(0, Expr::Int32)));
+  roots.push_back(AShrExpr::create(x, ZExtExpr::create(b0, Expr::Int32)));
+  roots.push_back(SelectExpr::create(EqExpr::create(b0,
+                                     ConstantExpr::create(3, Expr::Int8)),
+                                     ExtractExpr::create(x, 8, Expr::Int16),
+                                     SExtExpr::create(b0, Expr::Int16)));
+  roots.push_back(URemExpr::create(x, ConstantExpr::create(10, Expr::Int32)));
+  BatchEvaluator batch(roots);
+  ASSERT_TRUE(batch.isValid());
+
+  std::vector<Assignment*> storage;
+  std::vector<const Assignment*> assignments;
+  for (unsigned i = 0; i != 600; ++i) {
+    Assignment *a = new Assignment();
+    std::vector<unsigned char> &bytes = a->bindings[array];
+    for (unsigned k = 0; k != 4; ++k)
+      bytes.push_back((unsigned char) (i * 37 + k * 101));
+    storage.push_back(a);
+    assignments.push_back(a);
+  }
+  batch.evaluate(assignments);
+
+  for (unsigned i = 0; i != assignments.size(); ++i) {
+    ASSERT_TRUE(batch.isDetermined(i));
+    for (unsigned j = 0; j != roots.size(); ++j) {
+      ref<Expr> value = storage[i]->evaluate(roots[j]);
+      ASSERT_TRUE(isa<ConstantExpr>(value));
+      EXPECT_EQ(cast<ConstantExpr>(value)->getZExtValue(),
+                batch.getValue(j, i));
+    }
+  }
+
+  for (unsigned i = 0; i != storage.size(); ++i)
+    delete storage[i];
+}
+
+TEST(BatchEvaluatorTest, DivisionByZeroIsUndetermined) {
+  Array *array = new Array("arr", 4);
+  ref<Expr> x = Expr::createTempRead(array, 32);
+  BatchEvaluator batch(UDivExpr::create(ConstantExpr::create(100, Expr::Int32),
+                                        x));
+
+  Assignment zero, two;
+  zero.bindings[array] = std::vector<unsigned char>(4, 0);
+  two.bindings[array] = std::vector<unsigned char>(4, 0);
+  two.bindings[array][0] = 2;
+  std::vector<const Assignment*> assignments;
+  assignments.push_back(&zero);
+  assignments.push_back(&two);
+  batch.evaluate(assignments);
+
+  EXPECT_FALSE(batch.isDetermined(0));
+  EXPECT_TRUE(batch.isDetermined(1));
+  EXPECT_EQ(50U, batch.getValue(0, 1));
+}
+
+}
@@ -110,4 +110,29 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, ReadOverConstantArray) {
+  ref<ConstantExpr> values[4] = { ConstantExpr::create(1, Expr::Int8),
+                                  ConstantExpr::create(2, Expr::Int8),
+                                  ConstantExpr::create(3, Expr::Int8),
+                                  ConstantExpr::create(4, Expr::Int8) };
+  Array *array = new Array("arr4", 4, values, values + 4);
+  Array *array2 = new Array("arr5", 256);
+  ref<Expr> read8 = Expr::createTempRead(array2, 8);
+
+  UpdateList ul(array, 0);
+  ul.extend(ConstantExpr::create(1, Expr::Int32), read8);
+
+  // Reads of untouched bytes fold to the initial contents.
+  EXPECT_EQ(ref<Expr>(values[2]),
+            ReadExpr::create(ul, ConstantExpr::create(2, Expr::Int32)));
+  EXPECT_EQ(read8,
+            ReadExpr::create(ul, ConstantExpr::create(1, Expr::Int32)));
+
+  // Nothing can be said past a symbolic index.
+  ul.extend(ZExtExpr::create(read8, Expr::Int32), 
+            ConstantExpr::create(0, Expr::Int8));
+  EXPECT_EQ(Expr::Read, 
+            ReadExpr::create(ul, ConstantExpr::create(2, Expr::Int32))->getKind());
+}
+
 }